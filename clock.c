@@ -1,54 +1,688 @@
+#define _GNU_SOURCE
 #include <SDL3/SDL.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <math.h>
+#include <stddef.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <time.h>
+#include <unistd.h>
+
+#include "frame_share.h"
+#include "pose_log.h"
+
+#ifdef __GLIBC__
+#include <execinfo.h>
+#include <malloc.h>
+#include <pthread.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/inotify.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
 
 #define WINDOW_WIDTH 600
 #define WINDOW_HEIGHT 600
-#define CLOCK_RADIUS 250
 #define CENTER_X (WINDOW_WIDTH / 2)
 #define CENTER_Y (WINDOW_HEIGHT / 2)
+#define MAX_FACE_ELEMENTS 64
+#define MAX_FACE_LINE 256
+#define MAX_FACE_EXTENT WINDOW_WIDTH // radius and length, in window space
+#define MAX_FACE_THICKNESS 32 // a hand draws thickness^2 lines per frame
+#define FACE_CACHE_MAGIC 0x31434643u // "CFC1"
+#define FACE_CACHE_VERSION 1
+#define RELOAD_POLL_MS 250
+#define RELOAD_SETTLE_MS 50
+#define RENDER_PROBE_WARMUP 10
+#define RENDER_PROBE_FRAMES 60
+#define FRAME_HISTORY 4096 // power of two; FrameStats indexes modulo it
+#define FRAME_INTERVAL_NS 100000000ULL
+#define MAX_DISPLAYS 16   // --displays indices are bits of a Uint32
+#define DISPLAY_BUFFERS 3 // ready, being uploaded, being drawn
+#define DISPLAY_WAIT_MS 4 // longest the loop waits for other displays
+#define SWISS_SWEEP_MS 58500
+#define TICK_SETTLE_MS 80
+#define TICK_STIFFNESS 16900.0 // 130 rad/s
+#define TICK_DAMPING 117.0     // damping ratio 0.45
+#define DEFAULT_REFRESH_NS 16666667ULL
+#define PLL_PHASE_GAIN 4   // phase takes 1/N of each prediction error
+#define PLL_PERIOD_GAIN 32 // period takes 1/N of it, per refresh
+#define STATS_WINDOW_NS 5000000000ULL
+#define STATS_MAX_CLIENTS 16
+#define STATS_RESPONSE_MAX 2048
+#define STATS_CLIENT_TIMEOUT_NS 1000000000ULL
+#define MAX_HISTOGRAM_BUCKETS 16
+#define WATCHDOG_MAX_FRAMES 64
+#define SYNC_MAGIC 0x434e5953u // "SYNC"
+#define SYNC_VERSION 1
+#define SYNC_DEFAULT_GROUP "239.255.77.77"
+#define SYNC_DEFAULT_PORT 47777
+#define SYNC_STALE_NS 1000000000ULL
+#define SYNC_CAPTURE_NS 5000000 // larger errors are corrected in one step
+#define SCREENSHOT_QUEUE 4
+#define PNG_STORED_BLOCK 65535
+#define TERMINAL_DEFAULT_COLS 80
+#define TERMINAL_DEFAULT_ROWS 24
+#define REALTIME_PRIORITY 10
+#define FALLBACK_NICENESS -10
+#ifdef __GLIBC__
+#define WATCHDOG_SIGNAL SIGUSR2
+#endif
+#define MAX_SOAK_DAYS 3660
+#define LOG_RING_SIZE 256 // entries per thread; power of two
+#define LOG_MAX_ARGS 8
+#define LOG_STRING_BYTES 256 // shared by an entry's %s arguments
+#define LOG_SITES 128 // call sites tracked per thread; power of two
+#define LOG_DEFAULT_RATE 10
+#define LOG_DRAIN_MS 20
+#define EVENT_LOG_MAGIC 0x43455243u // "CREC"
+#define EVENT_LOG_VERSION 2
+#define MAX_INJECTED_EVENTS 8
+#define SOAK_WARMUP_DAYS 2
+#define SOAK_TIME_STEP_MS 9973 // prime, so frames land on varied hand angles
+#define SOAK_DEFAULT_START "2028-01-15T00:00:00" // spans Feb 29 and March DST
+#define HASH_PRIME1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME3 0x165667B19E3779F9ULL
+#define HASH_PRIME4 0x85EBCA77C2B2AE63ULL
+#define HASH_PRIME5 0x27D4EB2F165667C5ULL
+
+// Used when no --face file is given; faces/default.face is the same face.
+static const char DEFAULT_FACE[] =
+    "background #000000\n"
+    "ring radius=250 segments=720 color=#ffffff\n"
+    "markers count=12 radius=250 color=#ffffff\n"
+    "hand hour length=120 thickness=6 color=#ffffff\n"
+    "hand minute length=180 thickness=4 color=#ffffff\n"
+    "hand second length=200 thickness=2 color=#ff0000\n"
+    "ring radius=8 segments=32 color=#ffffff\n";
+
+typedef struct {
+  Uint8 r, g, b, a;
+} FaceColor;
+
+typedef enum { HAND_HOUR, HAND_MINUTE, HAND_SECOND } HandKind;
+
+typedef enum { ELEMENT_RING, ELEMENT_MARKERS, ELEMENT_HAND } ElementKind;
+
+// One line of a face description, in unscaled window coordinates. A zero
+// marker length or thickness means "derive from the radius".
+typedef struct {
+  ElementKind kind;
+  HandKind hand;
+  FaceColor color;
+  float radius;
+  float length;
+  float thickness;
+  int segments;
+  int count;
+} FaceElement;
+
+typedef struct {
+  FaceColor background;
+  FaceElement elements[MAX_FACE_ELEMENTS];
+  int element_count;
+} Face;
+
+typedef enum { OP_LINE_STRIP, OP_LINE_LIST, OP_HAND } DisplayOpKind;
+
+// A face compiled for one scale factor. Rings and markers are tessellated
+// into screen-space points up front; hands keep only the parameters of their
+// per-frame rotation. Ops reference points by index so the list can be
+// copied or stored without fixing up pointers.
+typedef struct {
+  Uint32 kind;
+  FaceColor color;
+  Uint32 first;
+  Uint32 count;
+  Uint32 hand;
+  Sint32 length;
+  Sint32 thickness;
+} DisplayOp;
+
+typedef struct {
+  FaceColor background;
+  int center_x;
+  int center_y;
+  DisplayOp *ops;
+  int op_count;
+  SDL_FPoint *points;
+  int point_count;
+  void *mapping; // non-NULL when ops/points live in a mapped face cache
+  size_t mapping_size;
+} DisplayList;
+
+// On-disk layout of a compiled face. Everything after the header is
+// referenced by offset, so the file can be mapped anywhere and used in place.
+typedef struct {
+  Uint32 magic;
+  Uint32 version;
+  Uint64 source_hash;
+  float scale_factor;
+  FaceColor background;
+  Sint32 center_x;
+  Sint32 center_y;
+  Uint32 op_size;
+  Uint32 op_count;
+  Uint32 ops_offset;
+  Uint32 point_count;
+  Uint32 points_offset;
+  Uint32 reserved;
+} FaceCacheHeader;
+
+typedef struct {
+  double hour_angle;
+  double minute_angle;
+  double second_angle;
+} Pose;
+
+typedef enum { SYNC_OFF, SYNC_LEADER, SYNC_FOLLOWER } SyncRole;
+
+typedef enum { MOTION_SWEEP, MOTION_SWISS, MOTION_TICK } HandMotion;
+
+// A key press handed to the loop before the given frame, for recording
+// input in headless runs, where nothing else produces events.
+typedef struct {
+  SDL_Keycode key;
+  int frame;
+} InjectedEvent;
+
+typedef struct {
+  const char *config_path;
+  const char *face_path;
+  const char *cache_dir;
+  const char *render_driver;
+  int startup_trace;
+  int headless;
+  float scale;
+  int virtual_time;
+  Sint64 start_time_ms;
+  int time_step_ms;
+  int frames;
+  const char *screenshot_path;
+  const char *compare_path;
+  int tolerance;
+  int bench;
+  int bench_threshold_us;
+  int log_bench_ns; // time log_message against this budget and exit
+  const char *checksum_path;
+  int soak_days;
+  const char *pose_log_path;
+  const char *record_path;
+  const char *replay_path;
+  InjectedEvent injected[MAX_INJECTED_EVENTS];
+  int injected_count;
+  int log_level; // LogLevel
+  int log_rate;
+  const char *stats_socket_path;
+  const char *metrics_path;
+  int metrics_interval_ms;
+  int watchdog_ms;
+  const char *watchdog_log_path;
+  const char *realtime; // "fifo", "rr" or NULL
+  int cpu;              // -1 leaves affinity alone
+  int terminal;
+  const char *share_name;
+  const char *screenshot_dir;
+  SDL_PixelFormat pixel_format; // 0: XRGB8888 headless, GPU when windowed
+  const char *pixel_format_name;
+  int sync_role; // SYNC_OFF, SYNC_LEADER or SYNC_FOLLOWER
+  const char *sync_group;
+  int sync_port;
+  int sync_threshold_us;
+  int motion; // MOTION_SWEEP, MOTION_SWISS or MOTION_TICK
+  int predict_present;
+  Uint32 display_mask; // bit n selects display n; 0 for one default window
+} Options;
+
+typedef enum {
+  STARTUP_PROCESS,
+  STARTUP_MAIN,
+  STARTUP_SDL_INIT,
+  STARTUP_WINDOW,
+  STARTUP_RENDERER,
+  STARTUP_DISPLAY_LIST,
+  STARTUP_FIRST_PRESENT,
+  STARTUP_STAGE_COUNT
+} StartupStage;
+
+static const char *const STARTUP_STAGE_NAMES[STARTUP_STAGE_COUNT] = {
+    "process start", "main",         "SDL_Init",          "window",
+    "renderer",      "display list", "first present",
+};
+
+// Loads the display list on a worker thread while the main thread creates
+// the window and renderer. The scale factor is a guess until the window
+// exists.
+typedef struct {
+  const Options *options;
+  SDL_Thread *thread;
+  float scale_factor;
+  DisplayList list;
+  int ok;
+  Uint64 finished_ns;
+} DisplayListJob;
+
+// A window on one of the displays after the first with --displays. SDL
+// only allows window and GPU renderer calls on the main thread, so the
+// display's own thread draws each tick's pose in software into a free
+// surface, and the main loop uploads and presents the newest one.
+typedef struct {
+  SDL_DisplayID id;
+  SDL_Window *window;
+  SDL_Renderer *renderer;
+  SDL_Texture *texture;
+  SDL_Surface *surfaces[DISPLAY_BUFFERS];
+  SDL_Renderer *software[DISPLAY_BUFFERS];
+  float scale_factor;
+  DisplayList display_list;
+  void *pending; // reloaded list, swapped in by the display's thread
+  SDL_Thread *thread;
+  struct DisplaySet *set;
+  int ready;     // surface holding the newest finished frame, or -1
+  int uploading; // surface the main thread is reading, or -1
+  Uint64 started_tick;
+  Uint64 finished_tick;
+  Uint64 refresh_ns;   // the display's own refresh period, or 0
+  Uint64 presented_ns; // when the last present returned
+  Uint64 frames;   // presented
+  Uint64 skipped;  // ticks that passed while the thread was drawing
+  Uint64 deferred; // passes that ended with its newest frame unshown
+} DisplayContext;
+
+// One pose per tick, shared by every display's thread. `lock` guards the
+// tick and each display's buffer indices and tick counters.
+typedef struct DisplaySet {
+  SDL_Mutex *lock;
+  SDL_Condition *tick_ready;
+  SDL_Condition *frame_ready;
+  Pose pose;
+  Uint64 tick;
+  int stop;
+  DisplayContext displays[MAX_DISPLAYS];
+  int count;
+} DisplaySet;
+
+// Watches the config and face files and recompiles the display list off the
+// render thread. A finished list is parked in `pending` until the render
+// loop swaps it in between frames; lists for the other displays are parked
+// in theirs.
+typedef struct {
+  SDL_Thread *thread;
+  SDL_AtomicInt stop;
+  void *pending;
+  int argc;
+  char **argv;
+  float scale_factor;
+  DisplaySet *displays;
+} FaceReloader;
+
+typedef enum {
+  PHASE_IDLE,
+  PHASE_EVENTS,
+  PHASE_TIME,
+  PHASE_RENDER,
+  PHASE_PRESENT,
+  PHASE_LOG,
+  PHASE_HOUSEKEEPING, // soak sampling and first-frame setup
+  PHASE_COUNT
+} FramePhase;
+
+static const char *const FRAME_PHASE_NAMES[PHASE_COUNT] = {
+    "idle",    "event pump", "time fetch",  "render",
+    "present", "log writes", "housekeeping"};
+
+// The main loop bumps `heartbeat` on every phase change. A watchdog thread
+// that sees it stand still outside PHASE_IDLE for longer than the
+// threshold logs the phase and, where supported, the main thread's stack.
+typedef struct {
+  SDL_Thread *thread;
+  SDL_AtomicInt stop;
+  SDL_AtomicU32 heartbeat;
+  SDL_AtomicInt phase;
+  Uint32 beats; // main thread's copy of heartbeat
+  Uint64 frame; // accessed with __atomic builtins; the watchdog reads it
+  int threshold_ms;
+  int log_fd;
+#ifdef __GLIBC__
+  pthread_t target;
+#endif
+} Watchdog;
+
+typedef struct {
+  Uint64 present_ns;
+  Uint32 frame_ns;
+  Uint32 wake_late_ns;
+} FrameSample;
+
+// Per-frame instrumentation. Only the render thread writes; other threads
+// copy samples out and use `written` to discard slots overwritten while
+// they were copying. Counters wrap at 2^32.
+typedef struct {
+  FrameSample samples[FRAME_HISTORY];
+  SDL_AtomicU32 written;
+  SDL_AtomicU32 skipped_frames;
+  Uint64 start_ns;
+  const char *render_driver;
+} FrameStats;
+
+// Serves a JSON snapshot of FrameStats to each client that connects to a
+// Unix socket, from its own thread and without ever blocking the render
+// loop.
+typedef struct {
+  SDL_Thread *thread;
+  SDL_AtomicInt stop;
+  int listen_fd;
+  const char *path;
+  FrameStats *stats;
+} StatsServer;
+
+// Periodically folds new frame samples into cumulative histograms and
+// rewrites a Prometheus textfile-collector file with them.
+typedef struct {
+  SDL_Thread *thread;
+  SDL_AtomicInt stop;
+  const char *path;
+  int interval_ms;
+  FrameStats *stats;
+} MetricsExporter;
+
+// Shows the clock on a text terminal as Unicode braille, each cell holding
+// a 2x4 block of dots. The frame is still rendered by the software
+// renderer; only cells whose pattern changed since the last frame are
+// written.
+typedef struct {
+  int enabled;
+  int fd;
+  int cols;
+  int rows;
+  Uint8 *cells; // braille pattern currently on screen, per cell
+  Uint8 *next;  // the frame being built; swapped with cells once written
+  char *output;
+  size_t output_size;
+  int redraw;
+  Uint64 start_ns;
+  Uint64 frames;
+  Uint64 bytes;
+  Uint64 peak_bytes;
+} Terminal;
+
+static volatile sig_atomic_t terminal_quit;
+
+// Sent in network byte order by the leader right after each tick.
+typedef struct {
+  Uint32 magic;
+  Uint32 version;
+  Uint32 sequence;
+  Uint32 interval_ns;
+  Uint32 late_ns; // how long after its tick the leader sent this
+} SyncPacket;
+
+// Keeps several instances ticking in phase. The leader multicasts a packet
+// on every tick; a follower's thread timestamps arrivals, and its
+// scheduler moves its own ticks onto the leader's. Network delay is
+// assumed small next to the 1 ms target, as on one LAN segment.
+typedef struct {
+  SyncRole role;
+  int fd;
+  struct sockaddr_in group;
+  Uint32 sequence;
+  SDL_Thread *thread;
+  SDL_AtomicInt stop;
+  SDL_Mutex *lock;
+  Uint64 leader_tick_ns; // leader's latest tick on our monotonic clock
+  Uint32 leader_ticks;
+  Uint32 used_ticks;
+  int previous_large;
+  double errors_ms[FRAME_HISTORY]; // phase error at each leader tick
+  Uint64 error_count;
+} PhaseSync;
+
+// Predicts when the frame being drawn will reach the screen: at the first
+// refresh after it has been submitted. A second-order PLL keeps the
+// predicted refresh grid locked onto measured present times; a present
+// more than half a period off the prediction (a missed refresh) restarts
+// the grid from it.
+typedef struct {
+  int enabled;
+  Sint64 period_ns;    // refresh period estimate
+  Uint64 vblank_ns;    // a refresh on the predicted grid, 0 until the first
+  Sint64 submit_ns;    // smoothed time from sampling to presenting
+  Uint64 predicted_ns; // for the frame in flight
+  Uint64 slips;
+} PresentPredictor;
+
+typedef enum { EVENT_LOG_FRAME, EVENT_LOG_EVENT } EventLogKind;
+
+// A --record file: this header, then for each frame the SDL events polled
+// before it followed by the time it showed. Events are stored raw, so a log
+// only replays on the build that wrote it. The header keeps every setting
+// that changes what a frame draws, so a replay can match the recording.
+typedef struct {
+  Uint32 magic;
+  Uint32 version;
+  Uint32 record_size;
+  float scale_factor;
+  Uint32 motion;       // HandMotion
+  Uint32 pixel_format; // as --pixel-format, 0 for the default
+  Uint64 face_hash;    // of the face text, see face_text_hash
+  char face_path[256]; // empty for the built-in face
+  char tz[64];         // TZ at recording, empty if unset
+} EventLogHeader;
+
+typedef struct {
+  Uint32 kind;
+  Uint32 reserved;
+  Uint64 monotonic_ns; // when the event was polled or the time sampled
+  Sint64 time_ns;      // EVENT_LOG_FRAME: wall-clock time the frame showed
+  SDL_Event event;     // EVENT_LOG_EVENT
+} EventLogRecord;
+
+static volatile sig_atomic_t screenshot_signalled;
+
+typedef enum { LOG_ERROR, LOG_WARN, LOG_INFO, LOG_DEBUG } LogLevel;
+
+typedef union {
+  long long i;
+  unsigned long long u;
+  double d;
+  void *p;
+} LogArg;
+
+// One log call, formatted later by the writer. %s arguments are copied
+// into strings since the caller's buffers won't outlive the call; one cut
+// short ends in "...", and one with too little room left for that is
+// printed as "..." alone.
+typedef struct {
+  const char *format;
+  Uint64 time_ns;
+  int arg_count;
+  LogArg args[LOG_MAX_ARGS];
+  char strings[LOG_STRING_BYTES];
+} LogEntry;
+
+// A call site's argument types, so later calls needn't parse the format,
+// and its rate-limit state.
+typedef struct {
+  const char *format;
+  int arg_count;
+  char kinds[LOG_MAX_ARGS];
+  Uint64 window_ns; // start of this call site's current second
+  int count;
+} LogSite;
+
+// Written only by the thread that owns it, read only by the writer. The
+// counters use acquire/release __atomic builtins rather than SDL's
+// sequentially consistent ones, which cost a locked instruction per store.
+typedef struct LogRing {
+  LogEntry entries[LOG_RING_SIZE];
+  Uint32 head;       // next entry the writer prints
+  Uint32 tail;       // next entry the owner fills
+  Uint32 dropped;    // calls made while the ring was full
+  Uint32 suppressed; // calls over the rate limit
+  LogSite sites[LOG_SITES]; // open addressing on the format pointer
+  LogSite overflow; // shared by call sites beyond LOG_SITES
+  struct LogRing *next;
+} LogRing;
+
+// Log calls format nothing and never block: they copy their arguments into
+// the calling thread's ring (or count a drop when it's full) and a writer
+// thread prints them, oldest first. Outside start_logger/stop_logger they
+// print directly. Level and rate are atomics so a config reload can change
+// them under running threads.
+typedef struct {
+  SDL_AtomicInt level; // LogLevel; calls above it are ignored
+  SDL_AtomicInt rate;  // messages per second per call site, 0 unlimited
+  SDL_AtomicInt running;
+  void *rings; // LogRing list, pushed with compare-and-swap
+  SDL_Thread *thread;
+  Uint32 dropped;    // writer's running totals
+  Uint32 suppressed;
+} Logger;
+
+static Logger logger = {.level = {LOG_INFO}, .rate = {LOG_DEFAULT_RATE}};
+// The calling thread's ring: a plain TLS load, where SDL_GetTLS is a call
+// and a lookup
+static __thread LogRing *log_ring;
+
+typedef struct {
+  SDL_Surface *frame;
+  Uint64 requested_ns;
+  Uint64 stall_ns; // time the main thread spent reading the frame back
+} ScreenshotJob;
+
+// Encodes and writes screenshots on its own thread so the main loop only
+// pays for the readback. Captures arriving while the queue is full are
+// dropped rather than waited for.
+typedef struct {
+  SDL_Thread *thread;
+  SDL_Mutex *lock;
+  SDL_Condition *ready;
+  ScreenshotJob jobs[SCREENSHOT_QUEUE];
+  int head;
+  int count;
+  int stop;
+  const char *dir;
+} ScreenshotWorker;
+
+// With --share, frames are drawn straight into a shared-memory ring (see
+// frame_share.h) by one software renderer per slot. The renderer and
+// surface made by init_headless_clock are set aside while sharing.
+typedef struct {
+  const char *name;
+  int fd;
+  FrameShareHeader *header;
+  size_t size;
+  SDL_Surface *surfaces[FRAME_SHARE_SLOTS];
+  SDL_Renderer *renderers[FRAME_SHARE_SLOTS];
+  SDL_Surface *own_surface;
+  SDL_Renderer *own_renderer;
+  Uint64 frame;
+} FrameShare;
 
 typedef struct {
   SDL_Window *window;
   SDL_Renderer *renderer;
   float scale_factor;
   int running;
-  SDL_FPoint *circle_points;
-  int circle_point_count;
+  Options options;
+  DisplayList display_list;
+  FaceReloader reloader;
+  Uint64 startup_ns[STARTUP_STAGE_COUNT];
+  SDL_Surface *surface; // headless render target
+  Sint64 virtual_time_ms;
+  int capture_requested;
+  SDL_Surface *capture;
+  FrameStats stats;
+  Uint64 frame_count;
+  Uint64 skipped_frames;
+  Uint64 next_frame_ns; // scheduler deadline
+  Uint64 wake_late_ns;  // how late the last wake-up was
+  Uint64 refresh_ns;    // display refresh period, for animation bursts
+  StatsServer stats_server;
+  MetricsExporter metrics;
+  Watchdog watchdog;
+  Terminal terminal;
+  FrameShare share;
+  ScreenshotWorker screenshots;
+  PhaseSync sync;
+  PresentPredictor predictor;
+  DisplaySet displays; // windows on the other --displays
+  // With --pixel-format in a window, the face is rasterized in software and
+  // streamed to window_renderer through this texture
+  SDL_Renderer *window_renderer;
+  SDL_Texture *stream;
+  Uint16 palette565[256]; // index8 surface palette as RGB565
+  int palette_size;
+  Uint64 screenshot_requested_ns; // 0 unless a capture is pending
+  Sint64 frame_time_ms; // time shown by the last frame
+  Sint64 frame_time_ns;
+  Uint64 frame_sample_ns; // monotonic time frame_time_ns was sampled
+  FILE *checksum_log;
+  FILE *pose_log;
+  FILE *event_log;
+  FILE *replay;
+  char replay_face_path[256]; // face named by the replayed log's header
+  Uint64 replay_events;
+  Sint64 replay_time_ns;   // time the next replayed frame shows
+  Uint64 replay_first_ns;  // recorded monotonic span of the replay
+  Uint64 replay_last_ns;
 } Clock;
 
+typedef struct {
+  double rss_kb;
+  double heap_kb;
+  double sdl_allocations;
+  double frame_us;
+} SoakSample;
+
+// Resource usage sampled once per simulated day of a soak run.
+typedef struct {
+  SoakSample samples[MAX_SOAK_DAYS + 1];
+  int count;
+  Sint64 next_sample_ms;
+  Uint64 frames;
+  Uint64 frame_ns;
+  int last_isdst;
+  int dst_transitions;
+  int leap_days;
+} SoakMonitor;
+
+static SDL_AtomicInt face_cache_hits;
+static SDL_AtomicInt face_cache_misses;
+
 void draw_line(SDL_Renderer *renderer, int x1, int y1, int x2, int y2) {
   SDL_RenderLine(renderer, x1, y1, x2, y2);
 }
 
-void precompute_circle(Clock *clock, int radius) {
-  const int segments = 720;
-  clock->circle_point_count = segments + 1;
-  clock->circle_points = malloc(clock->circle_point_count * sizeof(SDL_FPoint));
-
+// Writes segments + 1 points, closing the loop.
+void precompute_circle(SDL_FPoint *points, int segments, int radius,
+                       int center_x, int center_y) {
   for (int i = 0; i <= segments; i++) {
     float angle = (float)i * 2.0f * M_PI / segments;
-    clock->circle_points[i].x = radius * cosf(angle);
-    clock->circle_points[i].y = radius * sinf(angle);
-  }
-}
-
-void draw_circle_outline(SDL_Renderer *renderer, Clock *clock, int center_x,
-                         int center_y) {
-  // Transform precomputed points to screen position
-  for (int i = 0; i < clock->circle_point_count; i++) {
-    clock->circle_points[i].x += center_x;
-    clock->circle_points[i].y += center_y;
-  }
-
-  SDL_RenderLines(renderer, clock->circle_points, clock->circle_point_count);
-
-  // Restore relative coordinates for next use
-  for (int i = 0; i < clock->circle_point_count; i++) {
-    clock->circle_points[i].x -= center_x;
-    clock->circle_points[i].y -= center_y;
+    points[i].x = center_x + radius * cosf(angle);
+    points[i].y = center_y + radius * sinf(angle);
   }
 }
 
@@ -65,164 +699,5140 @@ void draw_hand(SDL_Renderer *renderer, int center_x, int center_y, double angle,
   }
 }
 
-void draw_hour_markers(SDL_Renderer *renderer, int center_x, int center_y,
-                       int radius) {
-  int marker_length = radius / 12;
-  int marker_thickness = radius / 80;
+void marker_dimensions(const FaceElement *element, float scale_factor,
+                       int *radius, int *length, int *thickness) {
+  *radius = (int)(element->radius * scale_factor);
+  *length = element->length > 0 ? (int)(element->length * scale_factor)
+                                 : *radius / 12;
+  *thickness = element->thickness > 0
+                   ? (int)(element->thickness * scale_factor)
+                   : *radius / 80;
+}
+
+// Writes count * thickness * 4 points as independent line segments.
+void precompute_markers(SDL_FPoint *points, int count, int radius,
+                        int marker_length, int marker_thickness, int center_x,
+                        int center_y) {
+  int n = 0;
 
-  for (int hour = 0; hour < 12; hour++) {
-    double angle = hour * 30.0 * M_PI / 180.0;
+  for (int marker = 0; marker < count; marker++) {
+    double angle = marker * (360.0 / count) * M_PI / 180.0;
     int outer_x = center_x + (int)(radius * sin(angle));
     int outer_y = center_y - (int)(radius * cos(angle));
     int inner_x = center_x + (int)((radius - marker_length) * sin(angle));
     int inner_y = center_y - (int)((radius - marker_length) * cos(angle));
 
     for (int i = 0; i < marker_thickness; i++) {
-      draw_line(renderer, inner_x, inner_y + i, outer_x, outer_y + i);
-      draw_line(renderer, inner_x + i, inner_y, outer_x + i, outer_y);
+      points[n++] = (SDL_FPoint){inner_x, inner_y + i};
+      points[n++] = (SDL_FPoint){outer_x, outer_y + i};
+      points[n++] = (SDL_FPoint){inner_x + i, inner_y};
+      points[n++] = (SDL_FPoint){outer_x + i, outer_y};
     }
   }
 }
 
-int get_current_time(int *hours, int *minutes, int *seconds,
-                     int *milliseconds) {
-  struct timespec ts;
+int parse_color(const char *text, FaceColor *color) {
+  size_t length = strlen(text);
+  if (text[0] != '#' || (length != 7 && length != 9)) {
+    return 0;
+  }
 
-  if (clock_gettime(CLOCK_REALTIME, &ts) != 0) {
-    return -1;
+  char *end;
+  unsigned long value = strtoul(text + 1, &end, 16);
+  if (*end != '\0') {
+    return 0;
+  }
+  if (length == 7) {
+    value = (value << 8) | 0xff;
   }
 
-  struct tm *time_info = localtime(&ts.tv_sec);
-  if (time_info == NULL) {
-    return -1;
+  color->r = (value >> 24) & 0xff;
+  color->g = (value >> 16) & 0xff;
+  color->b = (value >> 8) & 0xff;
+  color->a = value & 0xff;
+  return 1;
+}
+
+int parse_face_attribute(FaceElement *element, const char *key,
+                         const char *value) {
+  char *end;
+
+  if (strcmp(key, "color") == 0) {
+    return parse_color(value, &element->color);
+  }
+  if (strcmp(key, "segments") == 0 || strcmp(key, "count") == 0) {
+    long number = strtol(value, &end, 10);
+    if (*end != '\0' || number <= 0 || number > 100000) {
+      return 0;
+    }
+    if (key[0] == 's') {
+      element->segments = (int)number;
+    } else {
+      element->count = (int)number;
+    }
+    return 1;
+  }
+
+  float number = strtof(value, &end);
+  float limit = strcmp(key, "thickness") == 0 ? MAX_FACE_THICKNESS
+                                              : MAX_FACE_EXTENT;
+  if (*end != '\0' || !(number >= 0 && number <= limit)) {
+    return 0;
+  }
+  if (strcmp(key, "radius") == 0) {
+    element->radius = number;
+  } else if (strcmp(key, "length") == 0) {
+    element->length = number;
+  } else if (strcmp(key, "thickness") == 0) {
+    element->thickness = number;
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+// Parses one tokenized line into face. Returns NULL on success or a
+// description of what was wrong.
+const char *parse_face_line(char **tokens, int token_count, Face *face) {
+  if (strcmp(tokens[0], "background") == 0) {
+    if (token_count != 2 || !parse_color(tokens[1], &face->background)) {
+      return "expected 'background #rrggbb'";
+    }
+    return NULL;
   }
 
-  *hours = time_info->tm_hour % 12;
-  *minutes = time_info->tm_min;
-  *seconds = time_info->tm_sec;
-  // printf("tv_sec: %03li\n", ts.tv_sec);
-  *milliseconds = (ts.tv_nsec / 1000000);
+  if (face->element_count == MAX_FACE_ELEMENTS) {
+    return "too many elements";
+  }
 
-  return 0;
+  FaceElement element = {0};
+  element.color = (FaceColor){255, 255, 255, 255};
+  int first_attribute = 1;
+
+  if (strcmp(tokens[0], "ring") == 0) {
+    element.kind = ELEMENT_RING;
+    element.segments = 360;
+  } else if (strcmp(tokens[0], "markers") == 0) {
+    element.kind = ELEMENT_MARKERS;
+    element.count = 12;
+  } else if (strcmp(tokens[0], "hand") == 0) {
+    element.kind = ELEMENT_HAND;
+    element.thickness = 1;
+    if (token_count < 2) {
+      return "expected 'hand hour|minute|second'";
+    } else if (strcmp(tokens[1], "hour") == 0) {
+      element.hand = HAND_HOUR;
+    } else if (strcmp(tokens[1], "minute") == 0) {
+      element.hand = HAND_MINUTE;
+    } else if (strcmp(tokens[1], "second") == 0) {
+      element.hand = HAND_SECOND;
+    } else {
+      return "expected 'hand hour|minute|second'";
+    }
+    first_attribute = 2;
+  } else {
+    return "unknown element";
+  }
+
+  for (int i = first_attribute; i < token_count; i++) {
+    char *value = strchr(tokens[i], '=');
+    if (value == NULL) {
+      return "expected key=value";
+    }
+    *value++ = '\0';
+    if (!parse_face_attribute(&element, tokens[i], value)) {
+      return "invalid attribute";
+    }
+  }
+
+  if (element.kind == ELEMENT_HAND ? element.length <= 0
+                                   : element.radius <= 0) {
+    return element.kind == ELEMENT_HAND ? "hand needs a length"
+                                        : "element needs a radius";
+  }
+
+  face->elements[face->element_count++] = element;
+  return NULL;
 }
 
-void render_clock(Clock *clock) {
-  SDL_SetRenderDrawColor(clock->renderer, 0, 0, 0, 255);
-  SDL_RenderClear(clock->renderer);
+int parse_face(const char *text, const char *source, Face *face) {
+  memset(face, 0, sizeof(*face));
+  face->background = (FaceColor){0, 0, 0, 255};
 
-  SDL_SetRenderDrawColor(clock->renderer, 255, 255, 255, 255);
+  int line_number = 0;
+  while (*text) {
+    const char *end = strchr(text, '\n');
+    size_t length = end ? (size_t)(end - text) : strlen(text);
+    line_number++;
 
-  int scaled_center_x = (int)(CENTER_X * clock->scale_factor);
-  int scaled_center_y = (int)(CENTER_Y * clock->scale_factor);
-  int scaled_radius = (int)(CLOCK_RADIUS * clock->scale_factor);
+    char line[MAX_FACE_LINE];
+    if (length >= sizeof(line)) {
+      fprintf(stderr, "%s:%d: line too long\n", source, line_number);
+      return 0;
+    }
+    memcpy(line, text, length);
+    line[length] = '\0';
+    text += end ? length + 1 : length;
 
-  draw_circle_outline(clock->renderer, clock, scaled_center_x, scaled_center_y);
-  draw_hour_markers(clock->renderer, scaled_center_x, scaled_center_y,
-                    scaled_radius);
+    char *tokens[16];
+    int token_count = 0;
+    char *save;
+    for (char *token = strtok_r(line, " \t\r", &save);
+         token != NULL && token_count < 16;
+         token = strtok_r(NULL, " \t\r", &save)) {
+      tokens[token_count++] = token;
+    }
+    if (token_count == 0 || tokens[0][0] == '#') {
+      continue;
+    }
 
-  int hours, minutes, seconds, milliseconds;
-  if (get_current_time(&hours, &minutes, &seconds, &milliseconds) != 0) {
-    fprintf(stderr, "Error: Unable to get current time\n");
-    exit(EXIT_FAILURE);
+    const char *error = parse_face_line(tokens, token_count, face);
+    if (error != NULL) {
+      fprintf(stderr, "%s:%d: %s\n", source, line_number, error);
+      return 0;
+    }
   }
 
-  // printf("Current time: %02d:%02d:%02d.%03d\n", hours == 0 ? 12 : hours,
-  //       minutes, seconds, milliseconds);
-  double hour_angle = (hours * 30.0) + (minutes * 0.5);
-  double minute_angle = (minutes * 6.0) + (seconds * 0.1);
-  double second_angle = (seconds * 6.0) + (milliseconds * 0.006);
+  return 1;
+}
 
-  draw_hand(clock->renderer, scaled_center_x, scaled_center_y, hour_angle,
-            (int)(120 * clock->scale_factor), (int)(6 * clock->scale_factor));
-  draw_hand(clock->renderer, scaled_center_x, scaled_center_y, minute_angle,
-            (int)(180 * clock->scale_factor), (int)(4 * clock->scale_factor));
+char *read_file(const char *path, size_t *size) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return NULL;
+  }
 
-  SDL_SetRenderDrawColor(clock->renderer, 255, 0, 0, 255);
-  draw_hand(clock->renderer, scaled_center_x, scaled_center_y, second_angle,
-            (int)(200 * clock->scale_factor), (int)(2 * clock->scale_factor));
+  char *data = NULL;
+  size_t length = 0;
+  size_t capacity = 0;
+  size_t got;
+  do {
+    if (length + 4096 + 1 > capacity) {
+      capacity = capacity ? capacity * 2 : 8192;
+      char *grown = realloc(data, capacity);
+      if (grown == NULL) {
+        free(data);
+        fclose(file);
+        return NULL;
+      }
+      data = grown;
+    }
+    got = fread(data + length, 1, 4096, file);
+    length += got;
+  } while (got > 0);
 
-  SDL_SetRenderDrawColor(clock->renderer, 255, 255, 255, 255);
-  // Small center circle - use simple approach for tiny circles
-  const int segments = 32;
-  SDL_FPoint center_points[segments + 1];
-  int small_radius = (int)(8 * clock->scale_factor);
+  int failed = ferror(file);
+  fclose(file);
+  if (failed) {
+    free(data);
+    return NULL;
+  }
 
-  for (int i = 0; i <= segments; i++) {
-    float angle = (float)i * 2.0f * M_PI / segments;
-    center_points[i].x = scaled_center_x + small_radius * cosf(angle);
-    center_points[i].y = scaled_center_y + small_radius * sinf(angle);
+  data[length] = '\0';
+  if (size != NULL) {
+    *size = length;
   }
-  SDL_RenderLines(clock->renderer, center_points, segments + 1);
+  return data;
+}
 
-  SDL_RenderPresent(clock->renderer);
+int load_face(const char *path, Face *face) {
+  if (path == NULL) {
+    return parse_face(DEFAULT_FACE, "<default face>", face);
+  }
+
+  char *text = read_file(path, NULL);
+  if (text == NULL) {
+    fprintf(stderr, "Unable to read face %s\n", path);
+    return 0;
+  }
+
+  int ok = parse_face(text, path, face);
+  free(text);
+  return ok;
 }
 
-int init_clock(Clock *clock) {
-  if (!SDL_Init(SDL_INIT_VIDEO)) {
-    printf("SDL initialization failed: %s\n", SDL_GetError());
+void free_display_list(DisplayList *list) {
+  if (list->mapping != NULL) {
+    munmap(list->mapping, list->mapping_size);
+  } else {
+    free(list->ops);
+    free(list->points);
+  }
+  memset(list, 0, sizeof(*list));
+}
+
+int compile_face(const Face *face, float scale_factor, DisplayList *list) {
+  memset(list, 0, sizeof(*list));
+  list->background = face->background;
+  list->center_x = (int)(CENTER_X * scale_factor);
+  list->center_y = (int)(CENTER_Y * scale_factor);
+
+  int point_count = 0;
+  for (int i = 0; i < face->element_count; i++) {
+    const FaceElement *element = &face->elements[i];
+    int radius, length, thickness;
+
+    if (element->kind == ELEMENT_RING) {
+      point_count += element->segments + 1;
+    } else if (element->kind == ELEMENT_MARKERS) {
+      marker_dimensions(element, scale_factor, &radius, &length, &thickness);
+      point_count += element->count * thickness * 4;
+    }
+  }
+
+  list->ops = calloc((size_t)face->element_count + 1, sizeof(DisplayOp));
+  list->points = malloc(((size_t)point_count + 1) * sizeof(SDL_FPoint));
+  if (list->ops == NULL || list->points == NULL) {
+    free_display_list(list);
     return 0;
   }
 
-  clock->window =
-      SDL_CreateWindow("Analogue Clock", WINDOW_WIDTH, WINDOW_HEIGHT,
-                       SDL_WINDOW_HIGH_PIXEL_DENSITY);
+  for (int i = 0; i < face->element_count; i++) {
+    const FaceElement *element = &face->elements[i];
+    DisplayOp *op = &list->ops[list->op_count++];
+    SDL_FPoint *points = list->points + list->point_count;
+    int radius, length, thickness;
 
-  if (!clock->window) {
-    printf("Window creation failed: %s\n", SDL_GetError());
-    SDL_Quit();
+    op->color = element->color;
+    op->first = list->point_count;
+
+    switch (element->kind) {
+    case ELEMENT_RING:
+      op->kind = OP_LINE_STRIP;
+      op->count = element->segments + 1;
+      precompute_circle(points, element->segments,
+                        (int)(element->radius * scale_factor),
+                        list->center_x, list->center_y);
+      break;
+    case ELEMENT_MARKERS:
+      op->kind = OP_LINE_LIST;
+      marker_dimensions(element, scale_factor, &radius, &length, &thickness);
+      op->count = element->count * thickness * 4;
+      precompute_markers(points, element->count, radius, length, thickness,
+                         list->center_x, list->center_y);
+      break;
+    case ELEMENT_HAND:
+      op->kind = OP_HAND;
+      op->hand = element->hand;
+      op->length = (int)(element->length * scale_factor);
+      op->thickness = (int)(element->thickness * scale_factor);
+      break;
+    }
+
+    list->point_count += op->count;
+  }
+
+  return 1;
+}
+
+Uint64 hash_bytes(Uint64 hash, const void *data, size_t size) {
+  const Uint8 *bytes = data;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// Identifies the face source without reading it: the built-in text, or the
+// path plus the file's inode, size and timestamps. The timestamps include
+// nanoseconds, since a save and a reload can land in the same second.
+int face_source_hash(const char *path, Uint64 *hash) {
+  *hash = 0xcbf29ce484222325ULL;
+  if (path == NULL) {
+    *hash = hash_bytes(*hash, DEFAULT_FACE, sizeof(DEFAULT_FACE));
+    return 1;
+  }
+
+  struct stat st;
+  if (stat(path, &st) != 0) {
     return 0;
   }
+  Sint64 identity[6] = {(Sint64)st.st_ino,         (Sint64)st.st_size,
+                        (Sint64)st.st_mtim.tv_sec, st.st_mtim.tv_nsec,
+                        (Sint64)st.st_ctim.tv_sec, st.st_ctim.tv_nsec};
+  *hash = hash_bytes(*hash, path, strlen(path));
+  *hash = hash_bytes(*hash, identity, sizeof(identity));
+  return 1;
+}
 
-  clock->renderer = SDL_CreateRenderer(clock->window, NULL);
+// Builds the path of a file in the cache directory, creating the directory
+// (and, for the default locations, its parent) if needed.
+int cache_file_path(const Options *options, const char *name, char *path,
+                    size_t size) {
+  char dir[512];
+  const char *xdg = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
 
-  if (!clock->renderer) {
-    printf("Renderer creation failed: %s\n", SDL_GetError());
-    SDL_DestroyWindow(clock->window);
-    SDL_Quit();
+  if (options->cache_dir != NULL) {
+    snprintf(dir, sizeof(dir), "%s", options->cache_dir);
+  } else if (xdg != NULL && xdg[0] != '\0') {
+    snprintf(dir, sizeof(dir), "%s/clock", xdg);
+  } else if (home != NULL) {
+    snprintf(dir, sizeof(dir), "%s/.cache/clock", home);
+  } else {
     return 0;
   }
 
-  clock->scale_factor = SDL_GetWindowPixelDensity(clock->window);
-  clock->running = 1;
+  char *slash = strrchr(dir, '/');
+  if (slash != NULL && slash != dir) {
+    *slash = '\0';
+    mkdir(dir, 0755);
+    *slash = '/';
+  }
+  mkdir(dir, 0755);
+
+  int written = snprintf(path, size, "%s/%s", dir, name);
+  return written > 0 && (size_t)written < size;
+}
+
+// One cache file per face path and scale factor, so edits overwrite the
+// stale entry instead of accumulating new ones.
+int face_cache_path(const Options *options, float scale_factor, char *path,
+                    size_t size) {
+  const char *face = options->face_path ? options->face_path : "";
+  Uint64 hash = hash_bytes(0xcbf29ce484222325ULL, face, strlen(face));
 
-  // Precompute circle points for main clock face
-  precompute_circle(clock, (int)(CLOCK_RADIUS * clock->scale_factor));
+  char name[64];
+  snprintf(name, sizeof(name), "face-%016llx-%d.bin",
+           (unsigned long long)hash, (int)(scale_factor * 100));
+  return cache_file_path(options, name, path, size);
+}
 
+// The list is drawn straight from the mapping, so every op is checked once
+// here rather than on each frame, against what compile_face can produce.
+int valid_display_ops(const DisplayOp *ops, Uint32 op_count,
+                      Uint32 point_count, float scale_factor) {
+  Sint32 max_length = (Sint32)(MAX_FACE_EXTENT * scale_factor);
+  Sint32 max_thickness = (Sint32)(MAX_FACE_THICKNESS * scale_factor);
+  for (Uint32 i = 0; i < op_count; i++) {
+    const DisplayOp *op = &ops[i];
+    if (op->kind > OP_HAND || op->first > point_count ||
+        op->count > point_count - op->first || op->length < 0 ||
+        op->length > max_length || op->thickness < 0 ||
+        op->thickness > max_thickness) {
+      return 0;
+    }
+  }
   return 1;
 }
 
-void cleanup_clock(Clock *clock) {
-  free(clock->circle_points);
-  SDL_DestroyRenderer(clock->renderer);
-  SDL_DestroyWindow(clock->window);
-  SDL_Quit();
+int map_face_cache(const char *path, Uint64 source_hash, float scale_factor,
+                   DisplayList *list) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FaceCacheHeader)) {
+    close(fd);
+    return 0;
+  }
+
+  size_t size = (size_t)st.st_size;
+  void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return 0;
+  }
+
+  const FaceCacheHeader *header = mapping;
+  if (header->magic != FACE_CACHE_MAGIC ||
+      header->version != FACE_CACHE_VERSION ||
+      header->source_hash != source_hash ||
+      header->scale_factor != scale_factor ||
+      header->op_size != sizeof(DisplayOp) ||
+      header->ops_offset + (Uint64)header->op_count * sizeof(DisplayOp) >
+          size ||
+      header->points_offset + (Uint64)header->point_count * sizeof(SDL_FPoint) >
+          size ||
+      header->ops_offset % __alignof__(DisplayOp) != 0 ||
+      header->points_offset % __alignof__(SDL_FPoint) != 0 ||
+      !valid_display_ops(
+          (const DisplayOp *)((const Uint8 *)mapping + header->ops_offset),
+          header->op_count, header->point_count, scale_factor)) {
+    munmap(mapping, size);
+    return 0;
+  }
+
+  memset(list, 0, sizeof(*list));
+  list->background = header->background;
+  list->center_x = header->center_x;
+  list->center_y = header->center_y;
+  list->ops = (DisplayOp *)((Uint8 *)mapping + header->ops_offset);
+  list->op_count = header->op_count;
+  list->points = (SDL_FPoint *)((Uint8 *)mapping + header->points_offset);
+  list->point_count = header->point_count;
+  list->mapping = mapping;
+  list->mapping_size = size;
+  return 1;
 }
 
-void handle_events(Clock *clock) {
-  SDL_Event event;
-  while (SDL_PollEvent(&event)) {
-    if (event.type == SDL_EVENT_QUIT) {
-      clock->running = 0;
-    }
-    if (event.type == SDL_EVENT_KEY_DOWN && event.key.key == SDLK_ESCAPE) {
-      clock->running = 0;
-    }
+// Writes to a temporary file and renames it, so a reader never maps a
+// partially written cache.
+int write_face_cache(const char *path, Uint64 source_hash, float scale_factor,
+                     const DisplayList *list) {
+  FaceCacheHeader header = {0};
+  header.magic = FACE_CACHE_MAGIC;
+  header.version = FACE_CACHE_VERSION;
+  header.source_hash = source_hash;
+  header.scale_factor = scale_factor;
+  header.background = list->background;
+  header.center_x = list->center_x;
+  header.center_y = list->center_y;
+  header.op_size = sizeof(DisplayOp);
+  header.op_count = list->op_count;
+  header.ops_offset = sizeof(header);
+  header.point_count = list->point_count;
+  header.points_offset =
+      header.ops_offset + header.op_count * sizeof(DisplayOp);
+
+  char temp_path[600];
+  snprintf(temp_path, sizeof(temp_path), "%s.%ld.tmp", path, (long)getpid());
+  FILE *file = fopen(temp_path, "wb");
+  if (file == NULL) {
+    return 0;
+  }
+
+  int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+           fwrite(list->ops, sizeof(DisplayOp), list->op_count, file) ==
+               (size_t)list->op_count &&
+           fwrite(list->points, sizeof(SDL_FPoint), list->point_count,
+                  file) == (size_t)list->point_count;
+  ok = fclose(file) == 0 && ok;
+
+  if (!ok || rename(temp_path, path) != 0) {
+    remove(temp_path);
+    return 0;
   }
+  return 1;
 }
 
-int main(void) {
-  Clock clock = {0};
+// Maps the cached display list for this face and scale factor, compiling
+// and caching it first if the cache is missing or stale.
+int load_display_list(const Options *options, float scale_factor,
+                      DisplayList *list) {
+  Uint64 source_hash;
+  char cache_path[600];
+  int cacheable =
+      face_source_hash(options->face_path, &source_hash) &&
+      face_cache_path(options, scale_factor, cache_path, sizeof(cache_path));
 
-  if (!init_clock(&clock)) {
+  if (cacheable &&
+      map_face_cache(cache_path, source_hash, scale_factor, list)) {
+    SDL_AddAtomicInt(&face_cache_hits, 1);
     return 1;
   }
+  SDL_AddAtomicInt(&face_cache_misses, 1);
 
-  while (clock.running) {
-    handle_events(&clock);
-    render_clock(&clock);
-    SDL_Delay(100);
+  Face face;
+  if (!load_face(options->face_path, &face) ||
+      !compile_face(&face, scale_factor, list)) {
+    return 0;
   }
 
-  cleanup_clock(&clock);
-  return 0;
+  if (cacheable &&
+      !write_face_cache(cache_path, source_hash, scale_factor, list)) {
+    fprintf(stderr, "Unable to write face cache %s\n", cache_path);
+  }
+  return 1;
+}
+
+Uint64 monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (Uint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+Sint64 floor_div(Sint64 value, Sint64 divisor) {
+  Sint64 quotient = value / divisor;
+  return quotient - (value % divisor < 0);
+}
+
+// Steps over a printf conversion's flags, width, precision and length
+// modifier to its conversion character. *longs is the number of 'l's, or 3
+// for 'z'.
+const char *log_conversion(const char *c, int *longs) {
+  c += strspn(c, "-+ #0123456789.");
+  *longs = 0;
+  if (*c == 'z') {
+    *longs = 3;
+    return c + 1;
+  }
+  while (*c == 'l') {
+    (*longs)++;
+    c++;
+  }
+  return c;
+}
+
+// Records the type of each argument the format names, once per call site.
+// Parsing stops at a conversion it doesn't know, leaving the writer to print
+// the rest raw. The site's rate-limit window is left alone.
+void parse_log_site(LogSite *site, const char *format) {
+  int count = 0;
+  for (const char *c = strchr(format, '%'); c != NULL && count < LOG_MAX_ARGS;
+       c = strchr(c + 1, '%')) {
+    if (c[1] == '%') {
+      c++;
+      continue;
+    }
+    int longs;
+    c = log_conversion(c + 1, &longs);
+    char kind;
+    switch (*c) {
+    case 'd':
+    case 'i':
+    case 'c':
+      kind = "ilLz"[longs];
+      break;
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+      kind = "uUVZ"[longs];
+      break;
+    case 'e':
+    case 'f':
+    case 'g':
+      kind = 'f';
+      break;
+    case 'p':
+    case 's':
+      kind = *c;
+      break;
+    default:
+      kind = 0;
+    }
+    if (kind == 0 || longs > 3) {
+      break;
+    }
+    site->kinds[count++] = kind;
+  }
+  site->format = format;
+  site->arg_count = count;
+}
+
+// A call site keeps its slot, and so its rate-limit window, for the life
+// of the thread. Sites that find the table full share one slot and one
+// window, and are parsed again whenever they alternate.
+LogSite *find_log_site(LogRing *ring, const char *format) {
+  Uint32 home = ((uintptr_t)format >> 3) & (LOG_SITES - 1);
+  for (Uint32 i = 0; i < LOG_SITES; i++) {
+    LogSite *site = &ring->sites[(home + i) & (LOG_SITES - 1)];
+    if (site->format == format) {
+      return site;
+    }
+    if (site->format == NULL) {
+      parse_log_site(site, format);
+      return site;
+    }
+  }
+  if (ring->overflow.format != format) {
+    parse_log_site(&ring->overflow, format);
+  }
+  return &ring->overflow;
+}
+
+// Formats an entry as printf would have, one conversion at a time.
+void format_log_entry(const LogEntry *entry, char *line, size_t size) {
+  size_t length = 0;
+  int index = 0;
+  const char *c = entry->format;
+  while (*c != '\0' && length + 1 < size) {
+    const char *percent = strchr(c, '%');
+    if (percent == NULL || index == entry->arg_count) {
+      length += snprintf(line + length, size - length, "%s", c);
+      break;
+    }
+    size_t literal = (size_t)(percent - c);
+    if (literal > size - length - 1) {
+      literal = size - length - 1;
+    }
+    memcpy(line + length, c, literal);
+    length += literal;
+    if (percent[1] == '%') {
+      line[length++] = '%';
+      c = percent + 2;
+      continue;
+    }
+
+    int longs;
+    const char *conversion = log_conversion(percent + 1, &longs);
+    char spec[32];
+    size_t spec_length = (size_t)(conversion + 1 - percent);
+    if (length + 1 >= size || spec_length >= sizeof(spec)) {
+      break;
+    }
+    memcpy(spec, percent, spec_length);
+    spec[spec_length] = '\0';
+    const LogArg *arg = &entry->args[index++];
+    char *out = line + length;
+    size_t room = size - length;
+    int written = 0;
+    switch (*conversion) {
+    case 'd':
+    case 'i':
+    case 'c':
+      written = longs == 3   ? snprintf(out, room, spec, (size_t)arg->i)
+                : longs == 2 ? snprintf(out, room, spec, arg->i)
+                : longs == 1 ? snprintf(out, room, spec, (long)arg->i)
+                             : snprintf(out, room, spec, (int)arg->i);
+      break;
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+      written = longs == 3   ? snprintf(out, room, spec, (size_t)arg->u)
+                : longs == 2 ? snprintf(out, room, spec, arg->u)
+                : longs == 1 ? snprintf(out, room, spec, (unsigned long)arg->u)
+                             : snprintf(out, room, spec, (unsigned)arg->u);
+      break;
+    case 'e':
+    case 'f':
+    case 'g':
+      written = snprintf(out, room, spec, arg->d);
+      break;
+    case 'p':
+      written = snprintf(out, room, spec, arg->p);
+      break;
+    case 's':
+      written = snprintf(out, room, spec,
+                         arg->u < LOG_STRING_BYTES ? entry->strings + arg->u
+                                                   : "...");
+      break;
+    }
+    if (written < 0) {
+      break;
+    }
+    length += (size_t)written < room ? (size_t)written : room - 1;
+    c = conversion + 1;
+  }
+  line[length < size ? length : size - 1] = '\0';
+}
+
+// Allows `rate` calls from each call site per second.
+int log_rate_allows(LogSite *site, Uint64 now) {
+  int rate = SDL_GetAtomicInt(&logger.rate);
+  if (rate <= 0) {
+    return 1;
+  }
+  if (now - site->window_ns >= 1000000000ULL) {
+    site->window_ns = now;
+    site->count = 0;
+  }
+  return ++site->count <= rate;
+}
+
+LogRing *add_log_ring(void) {
+  LogRing *ring = calloc(1, sizeof(LogRing));
+  if (ring == NULL) {
+    return NULL;
+  }
+  do {
+    ring->next = SDL_GetAtomicPointer(&logger.rings);
+  } while (!SDL_CompareAndSwapAtomicPointer(&logger.rings, ring->next, ring));
+  log_ring = ring;
+  return ring;
+}
+
+// Orders entries across threads and paces rate limits. The coarse clock
+// ticks every few milliseconds but costs a fraction of a precise read.
+Uint64 log_time_ns(void) {
+  struct timespec ts;
+#ifdef __linux__
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+  return (Uint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Messages are single lines without a trailing newline.
+void log_message(LogLevel level, const char *format, ...) {
+  if ((int)level > SDL_GetAtomicInt(&logger.level)) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  if (!SDL_GetAtomicInt(&logger.running)) {
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+    return;
+  }
+
+  LogRing *ring = log_ring;
+  Uint64 now = log_time_ns();
+  if (ring == NULL && (ring = add_log_ring()) == NULL) {
+    va_end(args);
+    return;
+  }
+  LogSite *site = find_log_site(ring, format);
+  if (!log_rate_allows(site, now)) {
+    __atomic_store_n(&ring->suppressed, ring->suppressed + 1,
+                     __ATOMIC_RELAXED);
+    va_end(args);
+    return;
+  }
+  Uint32 tail = ring->tail;
+  if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) >= LOG_RING_SIZE) {
+    __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+    va_end(args);
+    return;
+  }
+  LogEntry *entry = &ring->entries[tail & (LOG_RING_SIZE - 1)];
+  entry->format = format;
+  entry->time_ns = now;
+  entry->arg_count = site->arg_count;
+  size_t used = 0;
+  for (int i = 0; i < site->arg_count; i++) {
+    LogArg *arg = &entry->args[i];
+    switch (site->kinds[i]) {
+    case 'i':
+      arg->i = va_arg(args, int);
+      break;
+    case 'l':
+      arg->i = va_arg(args, long);
+      break;
+    case 'L':
+      arg->i = va_arg(args, long long);
+      break;
+    case 'u':
+      arg->u = va_arg(args, unsigned int);
+      break;
+    case 'U':
+      arg->u = va_arg(args, unsigned long);
+      break;
+    case 'V':
+      arg->u = va_arg(args, unsigned long long);
+      break;
+    case 'z':
+    case 'Z':
+      arg->u = va_arg(args, size_t);
+      break;
+    case 'f':
+      arg->d = va_arg(args, double);
+      break;
+    case 'p':
+      arg->p = va_arg(args, void *);
+      break;
+    case 's': {
+      // Strings are copied back to back; the last ones may be truncated
+      const char *text = va_arg(args, const char *);
+      if (text == NULL) {
+        text = "(null)";
+      }
+      if (used == LOG_STRING_BYTES) {
+        arg->u = LOG_STRING_BYTES;
+        break;
+      }
+      size_t room = LOG_STRING_BYTES - used - 1;
+      size_t length = strnlen(text, room);
+      int cut = length == room && text[length] != '\0';
+      if (cut && length < 3) {
+        arg->u = LOG_STRING_BYTES; // no room for the marker either
+        break;
+      }
+      memcpy(entry->strings + used, text, length);
+      entry->strings[used + length] = '\0';
+      if (cut) {
+        memcpy(entry->strings + used + length - 3, "...", 3);
+      }
+      arg->u = used;
+      used += length + 1;
+      break;
+    }
+    }
+  }
+  va_end(args);
+  __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+// Prints everything queued, oldest first across threads, in one write.
+void drain_log_rings(void) {
+  static char batch[16384];
+  size_t length = 0;
+  Uint32 dropped = 0, suppressed = 0;
+  for (;;) {
+    LogRing *oldest = NULL;
+    const LogEntry *entry = NULL;
+    for (LogRing *ring = SDL_GetAtomicPointer(&logger.rings); ring != NULL;
+         ring = ring->next) {
+      Uint32 head = ring->head;
+      if (head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) {
+        continue;
+      }
+      const LogEntry *next = &ring->entries[head & (LOG_RING_SIZE - 1)];
+      if (entry == NULL || next->time_ns < entry->time_ns) {
+        oldest = ring;
+        entry = next;
+      }
+    }
+    if (oldest == NULL) {
+      break;
+    }
+    char line[512];
+    format_log_entry(entry, line, sizeof(line));
+    __atomic_store_n(&oldest->head, oldest->head + 1, __ATOMIC_RELEASE);
+
+    size_t line_length = strlen(line);
+    if (length + line_length + 1 > sizeof(batch)) {
+      fwrite(batch, 1, length, stderr);
+      length = 0;
+    }
+    memcpy(batch + length, line, line_length);
+    length += line_length;
+    batch[length++] = '\n';
+  }
+  for (LogRing *ring = SDL_GetAtomicPointer(&logger.rings); ring != NULL;
+       ring = ring->next) {
+    dropped += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+    suppressed += __atomic_load_n(&ring->suppressed, __ATOMIC_RELAXED);
+  }
+  if (dropped != logger.dropped || suppressed != logger.suppressed) {
+    length += snprintf(batch + length, sizeof(batch) - length,
+                       "(log: %u dropped, %u over the rate limit)\n",
+                       dropped - logger.dropped,
+                       suppressed - logger.suppressed);
+    if (length > sizeof(batch)) {
+      length = sizeof(batch);
+    }
+    logger.dropped = dropped;
+    logger.suppressed = suppressed;
+  }
+  fwrite(batch, 1, length, stderr);
+}
+
+int logger_thread(void *data) {
+  (void)data;
+  while (SDL_GetAtomicInt(&logger.running)) {
+    drain_log_rings();
+    SDL_Delay(LOG_DRAIN_MS);
+  }
+  drain_log_rings();
+  return 0;
+}
+
+void configure_logger(int level, int rate) {
+  SDL_SetAtomicInt(&logger.level, level);
+  SDL_SetAtomicInt(&logger.rate, rate);
+}
+
+// Without a writer thread, calls keep printing directly.
+void start_logger(void) {
+  SDL_SetAtomicInt(&logger.running, 1);
+  logger.thread = SDL_CreateThread(logger_thread, "logger", NULL);
+  if (logger.thread == NULL) {
+    SDL_SetAtomicInt(&logger.running, 0);
+    fprintf(stderr, "Unable to start logger: %s\n", SDL_GetError());
+  }
+}
+
+// Later calls print directly. Rings are never freed: a thread that saw the
+// logger running just before it stopped may still be filling its own.
+void stop_logger(void) {
+  if (logger.thread == NULL) {
+    return;
+  }
+  SDL_SetAtomicInt(&logger.running, 0);
+  SDL_WaitThread(logger.thread, NULL);
+  logger.thread = NULL;
+}
+
+// Nanoseconds since the epoch: the real time, or the virtual time the loop
+// advances by a fixed step per frame.
+int current_time_ns(const Clock *clock, Sint64 *epoch_ns) {
+  if (clock->replay != NULL) {
+    *epoch_ns = clock->replay_time_ns;
+    return 0;
+  }
+  if (clock->options.virtual_time) {
+    *epoch_ns = clock->virtual_time_ms * 1000000;
+    return 0;
+  }
+
+  struct timespec ts;
+  if (clock_gettime(CLOCK_REALTIME, &ts) != 0) {
+    return -1;
+  }
+  *epoch_ns = (Sint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  return 0;
+}
+
+int get_current_time(const Clock *clock, Sint64 lead_ns, Sint64 *epoch_ns_out,
+                     int *hours, int *minutes, int *seconds,
+                     int *milliseconds) {
+  Sint64 epoch_ns;
+  if (current_time_ns(clock, &epoch_ns) != 0) {
+    return -1;
+  }
+  epoch_ns += lead_ns;
+  *epoch_ns_out = epoch_ns;
+
+  Sint64 remainder = epoch_ns % 1000000000;
+  if (remainder < 0) {
+    remainder += 1000000000;
+  }
+  time_t epoch_seconds = (time_t)((epoch_ns - remainder) / 1000000000);
+
+  struct tm time_info;
+  if (localtime_r(&epoch_seconds, &time_info) == NULL) {
+    return -1;
+  }
+
+  *hours = time_info.tm_hour % 12;
+  *minutes = time_info.tm_min;
+  *seconds = time_info.tm_sec;
+  *milliseconds = (int)(remainder / 1000000);
+
+  return 0;
+}
+
+double hand_angle(const Pose *pose, HandKind hand) {
+  switch (hand) {
+  case HAND_HOUR:
+    return pose->hour_angle;
+  case HAND_MINUTE:
+    return pose->minute_angle;
+  default:
+    return pose->second_angle;
+  }
+}
+
+void render_display_list(SDL_Renderer *renderer, const DisplayList *list,
+                         const Pose *pose) {
+  FaceColor background = list->background;
+  SDL_SetRenderDrawColor(renderer, background.r, background.g, background.b,
+                         background.a);
+  SDL_RenderClear(renderer);
+
+  for (int i = 0; i < list->op_count; i++) {
+    const DisplayOp *op = &list->ops[i];
+    const SDL_FPoint *points = list->points + op->first;
+
+    SDL_SetRenderDrawColor(renderer, op->color.r, op->color.g, op->color.b,
+                           op->color.a);
+    switch (op->kind) {
+    case OP_LINE_STRIP:
+      SDL_RenderLines(renderer, points, op->count);
+      break;
+    case OP_LINE_LIST:
+      for (Uint32 j = 0; j + 1 < op->count; j += 2) {
+        SDL_RenderLine(renderer, points[j].x, points[j].y, points[j + 1].x,
+                       points[j + 1].y);
+      }
+      break;
+    case OP_HAND:
+      draw_hand(renderer, list->center_x, list->center_y,
+                hand_angle(pose, op->hand), op->length, op->thickness);
+      break;
+    }
+  }
+}
+
+void record_frame(Clock *clock, Uint64 frame_start, Uint64 present_ns) {
+  FrameStats *stats = &clock->stats;
+  FrameSample *sample = &stats->samples[clock->frame_count % FRAME_HISTORY];
+  Uint64 frame_ns = present_ns - frame_start;
+
+  sample->present_ns = present_ns;
+  sample->frame_ns = frame_ns > UINT32_MAX ? UINT32_MAX : (Uint32)frame_ns;
+  sample->wake_late_ns = clock->wake_late_ns > UINT32_MAX
+                             ? UINT32_MAX
+                             : (Uint32)clock->wake_late_ns;
+  clock->frame_count++;
+  SDL_MemoryBarrierRelease();
+  SDL_SetAtomicU32(&stats->written, (Uint32)clock->frame_count);
+}
+
+// Copies up to max of the most recent samples, oldest first, and returns
+// how many are intact. The last one copied is sample number *end - 1.
+int copy_frame_samples(FrameStats *stats, FrameSample *out, int max,
+                       Uint32 *end_out) {
+  Uint32 end = SDL_GetAtomicU32(&stats->written);
+  SDL_MemoryBarrierAcquire();
+  Uint32 available = end < FRAME_HISTORY ? end : FRAME_HISTORY;
+  Uint32 count = available < (Uint32)max ? available : (Uint32)max;
+  Uint32 start = end - count;
+
+  for (Uint32 i = 0; i < count; i++) {
+    out[i] = stats->samples[(start + i) % FRAME_HISTORY];
+  }
+
+  // The writer may have lapped the oldest slots while they were copied
+  SDL_MemoryBarrierAcquire();
+  Uint32 lapped = SDL_GetAtomicU32(&stats->written) - end;
+  if (end_out != NULL) {
+    *end_out = end;
+  }
+  if (lapped >= count) {
+    return 0;
+  }
+  memmove(out, out + lapped, (count - lapped) * sizeof(FrameSample));
+  return (int)(count - lapped);
+}
+
+// XXH64-style streaming hash over 64-bit words, four independent lanes per
+// 32-byte stripe.
+typedef struct {
+  Uint64 lanes[4];
+  Uint64 stripe[4];
+  int buffered;
+  Uint64 length;
+} FrameHash;
+
+Uint64 hash_round(Uint64 accumulator, Uint64 input) {
+  accumulator += input * HASH_PRIME2;
+  accumulator = (accumulator << 31) | (accumulator >> 33);
+  return accumulator * HASH_PRIME1;
+}
+
+Uint64 hash_merge(Uint64 accumulator, Uint64 lane) {
+  accumulator ^= hash_round(0, lane);
+  return accumulator * HASH_PRIME1 + HASH_PRIME4;
+}
+
+void frame_hash_init(FrameHash *hash) {
+  memset(hash, 0, sizeof(*hash));
+  hash->lanes[0] = HASH_PRIME1 + HASH_PRIME2;
+  hash->lanes[1] = HASH_PRIME2;
+  hash->lanes[2] = 0;
+  hash->lanes[3] = 0 - HASH_PRIME1;
+}
+
+void frame_hash_word(FrameHash *hash, Uint64 word) {
+  hash->stripe[hash->buffered++] = word;
+  hash->length += 8;
+  if (hash->buffered == 4) {
+    for (int i = 0; i < 4; i++) {
+      hash->lanes[i] = hash_round(hash->lanes[i], hash->stripe[i]);
+    }
+    hash->buffered = 0;
+  }
+}
+
+Uint64 frame_hash_final(const FrameHash *hash) {
+  const Uint64 *v = hash->lanes;
+  Uint64 h = ((v[0] << 1) | (v[0] >> 63)) + ((v[1] << 7) | (v[1] >> 57)) +
+             ((v[2] << 12) | (v[2] >> 52)) + ((v[3] << 18) | (v[3] >> 46));
+  for (int i = 0; i < 4; i++) {
+    h = hash_merge(h, v[i]);
+  }
+  h += hash->length;
+
+  for (int i = 0; i < hash->buffered; i++) {
+    h ^= hash_round(0, hash->stripe[i]);
+    h = ((h << 27) | (h >> 37)) * HASH_PRIME1 + HASH_PRIME4;
+  }
+
+  h ^= h >> 33;
+  h *= HASH_PRIME2;
+  h ^= h >> 29;
+  h *= HASH_PRIME3;
+  h ^= h >> 32;
+  return h;
+}
+
+// Hashes the visible colour of every pixel as 0x00RRGGBB, so frames read
+// back from different backends and pixel formats compare equal when they
+// look the same.
+Uint64 hash_surface(SDL_Surface *surface) {
+  SDL_Surface *converted = NULL;
+  if (surface->format != SDL_PIXELFORMAT_XRGB8888 &&
+      surface->format != SDL_PIXELFORMAT_ARGB8888) {
+    converted = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_XRGB8888);
+    if (converted == NULL) {
+      return 0;
+    }
+    surface = converted;
+  }
+
+  FrameHash hash;
+  frame_hash_init(&hash);
+  for (int y = 0; y < surface->h; y++) {
+    const Uint32 *row =
+        (const Uint32 *)((const Uint8 *)surface->pixels + y * surface->pitch);
+    int x = 0;
+    for (; x + 1 < surface->w; x += 2) {
+      frame_hash_word(&hash, ((Uint64)(row[x] & 0xffffff) << 32) |
+                                 (row[x + 1] & 0xffffff));
+    }
+    if (x < surface->w) {
+      frame_hash_word(&hash, (Uint64)(row[x] & 0xffffff) << 32);
+    }
+  }
+
+  SDL_DestroySurface(converted);
+  return frame_hash_final(&hash);
+}
+
+void format_time_ms(Sint64 epoch_ms, char *text, size_t size) {
+  Sint64 remainder = epoch_ms % 1000;
+  if (remainder < 0) {
+    remainder += 1000;
+  }
+  time_t seconds = (time_t)((epoch_ms - remainder) / 1000);
+  struct tm tm;
+  localtime_r(&seconds, &tm);
+
+  size_t length = strftime(text, size, "%Y-%m-%dT%H:%M:%S", &tm);
+  snprintf(text + length, size - length, ".%03d", (int)remainder);
+}
+
+// One "<time shown> <hash>" line per frame, so two runs can be diffed.
+void log_frame_checksum(Clock *clock, SDL_Surface *frame) {
+  char time_text[64];
+  format_time_ms(clock->frame_time_ms, time_text, sizeof(time_text));
+  fprintf(clock->checksum_log, "%s %016llx\n", time_text,
+          frame ? (unsigned long long)hash_surface(frame) : 0ULL);
+}
+
+void terminal_signal(int signal) {
+  (void)signal;
+  terminal_quit = 1;
+}
+
+int write_all(int fd, const char *data, size_t length) {
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return 0;
+    }
+    data += written;
+    length -= written;
+  }
+  return 1;
+}
+
+int start_terminal(Terminal *terminal) {
+  terminal->fd = STDOUT_FILENO;
+  if (!isatty(terminal->fd)) {
+    fprintf(stderr, "--terminal needs stdout to be a terminal\n");
+    return 0;
+  }
+  signal(SIGINT, terminal_signal);
+  signal(SIGTERM, terminal_signal);
+
+  // Alternate screen, cursor hidden
+  const char *setup = "\x1b[?1049h\x1b[?25l";
+  write_all(terminal->fd, setup, strlen(setup));
+  terminal->enabled = 1;
+  terminal->redraw = 1;
+  terminal->start_ns = monotonic_ns();
+  return 1;
+}
+
+void finish_terminal(Terminal *terminal) {
+  if (!terminal->enabled) {
+    return;
+  }
+  const char *restore = "\x1b[?25h\x1b[?1049l";
+  write_all(terminal->fd, restore, strlen(restore));
+  terminal->enabled = 0;
+  free(terminal->cells);
+  free(terminal->next);
+  free(terminal->output);
+
+  if (terminal->frames > 0) {
+    double seconds = (monotonic_ns() - terminal->start_ns) / 1e9;
+    fprintf(stderr,
+            "terminal: %llu frames, %.1f bytes/frame mean, %llu peak, "
+            "%.0f bytes/s\n",
+            (unsigned long long)terminal->frames,
+            (double)terminal->bytes / terminal->frames,
+            (unsigned long long)terminal->peak_bytes,
+            seconds > 0 ? terminal->bytes / seconds : 0.0);
+  }
+}
+
+// Picks up the terminal's size, reallocating and forcing a full redraw
+// when it changes.
+int resize_terminal(Terminal *terminal) {
+  struct winsize size;
+  int cols = TERMINAL_DEFAULT_COLS;
+  int rows = TERMINAL_DEFAULT_ROWS;
+  if (ioctl(terminal->fd, TIOCGWINSZ, &size) == 0 && size.ws_col > 0 &&
+      size.ws_row > 0) {
+    cols = size.ws_col;
+    rows = size.ws_row;
+  }
+  if (terminal->cells != NULL && cols == terminal->cols &&
+      rows == terminal->rows) {
+    return 1;
+  }
+
+  free(terminal->cells);
+  free(terminal->next);
+  free(terminal->output);
+  terminal->cols = cols;
+  terminal->rows = rows;
+  terminal->cells = calloc((size_t)cols * rows, 1);
+  terminal->next = calloc((size_t)cols * rows, 1);
+  // Worst case every cell needs a cursor move and a 3-byte character
+  terminal->output_size = (size_t)cols * rows * 16 + 16;
+  terminal->output = malloc(terminal->output_size);
+  terminal->redraw = 1;
+  return terminal->cells != NULL && terminal->next != NULL &&
+         terminal->output != NULL;
+}
+
+void present_terminal(Terminal *terminal, SDL_Surface *surface,
+                      FaceColor background) {
+  static const Uint8 DOT_BITS[4][2] = {
+      {0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+
+  if (!resize_terminal(terminal)) {
+    return;
+  }
+
+  // Dots are roughly square, so fit a square grid of them
+  int side = terminal->cols * 2 < terminal->rows * 4 ? terminal->cols * 2
+                                                     : terminal->rows * 4;
+  int cell_cols = (side + 1) / 2;
+  int cell_rows = (side + 3) / 4;
+  int left = (terminal->cols - cell_cols) / 2;
+  Uint8 *next = terminal->next;
+  memset(next, 0, (size_t)terminal->cols * terminal->rows);
+
+  Uint32 background_pixel =
+      SDL_MapSurfaceRGB(surface, background.r, background.g, background.b);
+  int bytes_per_pixel = SDL_BYTESPERPIXEL(surface->format);
+  Uint32 mask = bytes_per_pixel == 4 ? 0xffffff
+                                     : (1u << (bytes_per_pixel * 8)) - 1;
+  background_pixel &= mask;
+  for (int y = 0; y < surface->h; y++) {
+    const Uint8 *row = (const Uint8 *)surface->pixels + y * surface->pitch;
+    int dot_y = y * side / surface->h;
+    Uint8 *cells = next + (size_t)(dot_y / 4) * terminal->cols + left;
+    for (int x = 0; x < surface->w; x++) {
+      Uint32 pixel = bytes_per_pixel == 4   ? ((const Uint32 *)row)[x]
+                     : bytes_per_pixel == 2 ? ((const Uint16 *)row)[x]
+                                            : row[x];
+      if ((pixel & mask) != background_pixel) {
+        int dot_x = x * side / surface->w;
+        cells[dot_x / 2] |= DOT_BITS[dot_y % 4][dot_x % 2];
+      }
+    }
+  }
+
+  size_t length = 0;
+  char *out = terminal->output;
+  // After a clear only the non-blank cells need writing
+  if (terminal->redraw) {
+    memset(terminal->cells, 0, (size_t)terminal->cols * terminal->rows);
+    length += snprintf(out, terminal->output_size, "\x1b[2J");
+    terminal->redraw = 0;
+  }
+  for (int r = 0; r < cell_rows; r++) {
+    int cursor = -1; // column the cursor is at, if on this row
+    const Uint8 *shown = terminal->cells + (size_t)r * terminal->cols + left;
+    const Uint8 *drawn = next + (size_t)r * terminal->cols + left;
+    for (int c = 0; c < cell_cols; c++) {
+      Uint8 pattern = drawn[c];
+      if (pattern == shown[c]) {
+        continue;
+      }
+      if (cursor != c) {
+        length += snprintf(out + length, terminal->output_size - length,
+                           "\x1b[%d;%dH", r + 1, left + c + 1);
+      }
+      // U+2800 + pattern in UTF-8
+      out[length++] = (char)0xe2;
+      out[length++] = (char)(0xa0 | (pattern >> 6));
+      out[length++] = (char)(0x80 | (pattern & 0x3f));
+      cursor = c + 1;
+    }
+  }
+  // Both buffers are zero outside the grid, so next is now what's shown
+  terminal->next = terminal->cells;
+  terminal->cells = next;
+
+  if (length > 0) {
+    write_all(terminal->fd, out, length);
+  }
+  terminal->frames++;
+  terminal->bytes += length;
+  if (length > terminal->peak_bytes) {
+    terminal->peak_bytes = length;
+  }
+}
+
+void screenshot_signal(int signal) {
+  (void)signal;
+  screenshot_signalled = 1;
+}
+
+Uint32 crc32_update(Uint32 crc, const Uint8 *data, size_t length) {
+  static Uint32 table[256];
+  if (table[1] == 0) {
+    for (Uint32 n = 0; n < 256; n++) {
+      Uint32 c = n;
+      for (int k = 0; k < 8; k++) {
+        c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      }
+      table[n] = c;
+    }
+  }
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+void put_be32(Uint8 *out, Uint32 value) {
+  out[0] = (Uint8)(value >> 24);
+  out[1] = (Uint8)(value >> 16);
+  out[2] = (Uint8)(value >> 8);
+  out[3] = (Uint8)value;
+}
+
+// Writes chunk data, folding it into the chunk's running CRC.
+void png_write(FILE *file, const void *data, size_t length, Uint32 *crc) {
+  fwrite(data, 1, length, file);
+  *crc = crc32_update(*crc, data, length);
+}
+
+void png_begin_chunk(FILE *file, const char *type, Uint32 length,
+                     Uint32 *crc) {
+  Uint8 length_bytes[4];
+  put_be32(length_bytes, length);
+  fwrite(length_bytes, 1, 4, file);
+  *crc = 0;
+  png_write(file, type, 4, crc);
+}
+
+void png_end_chunk(FILE *file, Uint32 crc) {
+  Uint8 crc_bytes[4];
+  put_be32(crc_bytes, crc);
+  fwrite(crc_bytes, 1, 4, file);
+}
+
+// An RGB24 surface as a PNG whose zlib stream uses stored (uncompressed)
+// deflate blocks: larger files, but no dependency and no compression time.
+int write_png(const char *path, SDL_Surface *rgb) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    return 0;
+  }
+  static const Uint8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a,
+                                     '\n'};
+  fwrite(signature, 1, sizeof(signature), file);
+
+  Uint32 crc;
+  Uint8 header[13] = {0};
+  put_be32(header, (Uint32)rgb->w);
+  put_be32(header + 4, (Uint32)rgb->h);
+  header[8] = 8; // bits per channel
+  header[9] = 2; // truecolour
+  png_begin_chunk(file, "IHDR", sizeof(header), &crc);
+  png_write(file, header, sizeof(header), &crc);
+  png_end_chunk(file, crc);
+
+  // Each row is a filter-type byte (none) followed by its pixels
+  size_t row_size = (size_t)rgb->w * 3 + 1;
+  size_t raw_size = row_size * rgb->h;
+  size_t blocks = (raw_size + PNG_STORED_BLOCK - 1) / PNG_STORED_BLOCK;
+  png_begin_chunk(file, "IDAT", (Uint32)(2 + raw_size + blocks * 5 + 4),
+                  &crc);
+  static const Uint8 zlib_header[2] = {0x78, 0x01};
+  png_write(file, zlib_header, 2, &crc);
+
+  Uint32 adler_a = 1, adler_b = 0;
+  size_t block_left = 0, written = 0;
+  for (int y = 0; y < rgb->h; y++) {
+    const Uint8 *pixels = (const Uint8 *)rgb->pixels + (size_t)y * rgb->pitch;
+    for (size_t x = 0; x < row_size;) {
+      if (block_left == 0) {
+        block_left = raw_size - written < PNG_STORED_BLOCK
+                         ? raw_size - written
+                         : PNG_STORED_BLOCK;
+        Uint8 block[5] = {written + block_left == raw_size,
+                          (Uint8)block_left, (Uint8)(block_left >> 8),
+                          (Uint8)~block_left, (Uint8)(~block_left >> 8)};
+        png_write(file, block, sizeof(block), &crc);
+      }
+      // Byte 0 of the row is the filter type, the rest are pixels
+      const Uint8 *data = x == 0 ? (const Uint8 *)"" : pixels + x - 1;
+      size_t length = x == 0 ? 1 : row_size - x;
+      if (length > block_left) {
+        length = block_left;
+      }
+      png_write(file, data, length, &crc);
+      for (size_t i = 0; i < length; i++) {
+        adler_a = (adler_a + data[i]) % 65521;
+        adler_b = (adler_b + adler_a) % 65521;
+      }
+      x += length;
+      written += length;
+      block_left -= length;
+    }
+  }
+  Uint8 adler[4];
+  put_be32(adler, (adler_b << 16) | adler_a);
+  png_write(file, adler, 4, &crc);
+  png_end_chunk(file, crc);
+
+  png_begin_chunk(file, "IEND", 0, &crc);
+  png_end_chunk(file, crc);
+  return fclose(file) == 0;
+}
+
+int screenshot_thread(void *data) {
+  ScreenshotWorker *worker = data;
+
+  SDL_LockMutex(worker->lock);
+  for (;;) {
+    while (worker->count == 0 && !worker->stop) {
+      SDL_WaitCondition(worker->ready, worker->lock);
+    }
+    if (worker->count == 0) {
+      break;
+    }
+    ScreenshotJob job = worker->jobs[worker->head];
+    worker->head = (worker->head + 1) % SCREENSHOT_QUEUE;
+    worker->count--;
+    SDL_UnlockMutex(worker->lock);
+
+    // One reading for both fields, so names sort in capture order
+    char stamp[32];
+    char path[4096];
+    struct timespec now;
+    struct tm now_tm;
+    clock_gettime(CLOCK_REALTIME, &now);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S",
+             localtime_r(&now.tv_sec, &now_tm));
+    snprintf(path, sizeof(path), "%s/clock-%s-%03d.png", worker->dir, stamp,
+             (int)(now.tv_nsec / 1000000));
+
+    SDL_Surface *rgb = SDL_ConvertSurface(job.frame, SDL_PIXELFORMAT_RGB24);
+    if (rgb != NULL && write_png(path, rgb)) {
+      log_message(LOG_INFO,
+                  "Saved %s (main thread stalled %.2f ms, on disk %.1f ms "
+                  "after request)",
+                  path, job.stall_ns / 1e6,
+                  (monotonic_ns() - job.requested_ns) / 1e6);
+    } else {
+      log_message(LOG_ERROR, "Unable to save %s", path);
+    }
+    SDL_DestroySurface(rgb);
+    SDL_DestroySurface(job.frame);
+
+    SDL_LockMutex(worker->lock);
+  }
+  SDL_UnlockMutex(worker->lock);
+  return 0;
+}
+
+int start_screenshot_worker(ScreenshotWorker *worker, const char *dir) {
+  worker->dir = dir;
+  worker->lock = SDL_CreateMutex();
+  worker->ready = SDL_CreateCondition();
+  if (worker->lock != NULL && worker->ready != NULL) {
+    worker->thread =
+        SDL_CreateThread(screenshot_thread, "screenshots", worker);
+  }
+  if (worker->thread == NULL) {
+    log_message(LOG_ERROR, "Unable to start screenshot worker: %s",
+                SDL_GetError());
+    SDL_DestroyCondition(worker->ready);
+    SDL_DestroyMutex(worker->lock);
+    return 0;
+  }
+  return 1;
+}
+
+// Hands a frame to the worker, which takes ownership of it.
+void queue_screenshot(ScreenshotWorker *worker, SDL_Surface *frame,
+                      Uint64 requested_ns, Uint64 stall_ns) {
+  SDL_LockMutex(worker->lock);
+  if (worker->count == SCREENSHOT_QUEUE) {
+    SDL_UnlockMutex(worker->lock);
+    log_message(LOG_WARN, "Screenshot dropped; %d already pending",
+                SCREENSHOT_QUEUE);
+    SDL_DestroySurface(frame);
+    return;
+  }
+  int tail = (worker->head + worker->count) % SCREENSHOT_QUEUE;
+  worker->jobs[tail] = (ScreenshotJob){frame, requested_ns, stall_ns};
+  worker->count++;
+  SDL_SignalCondition(worker->ready);
+  SDL_UnlockMutex(worker->lock);
+}
+
+// Pending screenshots are finished before this returns.
+void stop_screenshot_worker(ScreenshotWorker *worker) {
+  if (worker->thread == NULL) {
+    return;
+  }
+  SDL_LockMutex(worker->lock);
+  worker->stop = 1;
+  SDL_SignalCondition(worker->ready);
+  SDL_UnlockMutex(worker->lock);
+  SDL_WaitThread(worker->thread, NULL);
+  worker->thread = NULL;
+  SDL_DestroyCondition(worker->ready);
+  SDL_DestroyMutex(worker->lock);
+}
+
+size_t round_up(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+int start_frame_share(Clock *clock, const char *name) {
+  FrameShare *share = &clock->share;
+  int width = clock->surface->w;
+  int height = clock->surface->h;
+  SDL_PixelFormat format = clock->surface->format;
+  if (format == SDL_PIXELFORMAT_INDEX8) {
+    fprintf(stderr, "--share can't publish index8 frames (no palette)\n");
+    return 0;
+  }
+  size_t pitch = (size_t)width * SDL_BYTESPERPIXEL(format);
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t frame_offset = round_up(sizeof(FrameShareHeader), page);
+  size_t frame_size = round_up(pitch * height, page);
+
+  // A segment left behind by a previous run would keep its old size
+  shm_unlink(name);
+  share->fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (share->fd < 0) {
+    fprintf(stderr, "Unable to create shared memory %s: %s\n", name,
+            strerror(errno));
+    return 0;
+  }
+  share->size = frame_offset + frame_size * FRAME_SHARE_SLOTS;
+  void *mapping = MAP_FAILED;
+  if (ftruncate(share->fd, (off_t)share->size) == 0) {
+    mapping = mmap(NULL, share->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   share->fd, 0);
+  }
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "Unable to map shared memory %s: %s\n", name,
+            strerror(errno));
+    close(share->fd);
+    shm_unlink(name);
+    return 0;
+  }
+  share->name = name;
+  share->header = mapping;
+
+  for (int i = 0; i < FRAME_SHARE_SLOTS; i++) {
+    Uint8 *pixels = (Uint8 *)mapping + frame_offset + frame_size * i;
+    share->surfaces[i] =
+        SDL_CreateSurfaceFrom(width, height, format, pixels, (int)pitch);
+    share->renderers[i] = share->surfaces[i]
+                              ? SDL_CreateSoftwareRenderer(share->surfaces[i])
+                              : NULL;
+    if (share->renderers[i] == NULL) {
+      fprintf(stderr, "Shared frame setup failed: %s\n", SDL_GetError());
+      return 0;
+    }
+  }
+
+  FrameShareHeader *header = share->header;
+  header->version = FRAME_SHARE_VERSION;
+  header->width = width;
+  header->height = height;
+  header->pitch = (Uint32)pitch;
+  header->format = format;
+  header->slot_count = FRAME_SHARE_SLOTS;
+  header->frame_offset = (Uint32)frame_offset;
+  header->frame_size = (Uint32)frame_size;
+  // Readers wait for the magic before trusting anything else
+  __atomic_store_n(&header->magic, FRAME_SHARE_MAGIC, __ATOMIC_RELEASE);
+
+  share->own_surface = clock->surface;
+  share->own_renderer = clock->renderer;
+  return 1;
+}
+
+// Points the clock at the next slot and marks it as being drawn.
+void begin_shared_frame(Clock *clock) {
+  FrameShare *share = &clock->share;
+  Uint64 frame = ++share->frame;
+  int slot = (int)((frame - 1) % FRAME_SHARE_SLOTS);
+
+  __atomic_store_n(&share->header->slots[slot].sequence, frame * 2 - 1,
+                   __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  clock->surface = share->surfaces[slot];
+  clock->renderer = share->renderers[slot];
+}
+
+void wake_frame_readers(FrameShareHeader *header) {
+#ifdef __linux__
+  syscall(SYS_futex, &header->latest, FUTEX_WAKE, SDL_MAX_SINT32, NULL, NULL,
+          0);
+#else
+  (void)header;
+#endif
+}
+
+void publish_shared_frame(Clock *clock, Uint64 present_ns) {
+  FrameShare *share = &clock->share;
+  FrameShareSlot *slot =
+      &share->header->slots[(share->frame - 1) % FRAME_SHARE_SLOTS];
+
+  slot->time_ns = clock->frame_time_ns;
+  slot->present_ns = present_ns;
+  __atomic_store_n(&slot->sequence, share->frame * 2, __ATOMIC_RELEASE);
+  __atomic_store_n(&share->header->latest, (Uint32)share->frame,
+                   __ATOMIC_RELEASE);
+  wake_frame_readers(share->header);
+}
+
+void stop_frame_share(Clock *clock) {
+  FrameShare *share = &clock->share;
+  if (share->header == NULL) {
+    return;
+  }
+  __atomic_store_n(&share->header->closed, 1, __ATOMIC_RELEASE);
+  __atomic_add_fetch(&share->header->latest, 1, __ATOMIC_RELEASE);
+  wake_frame_readers(share->header);
+
+  if (share->own_renderer != NULL) {
+    clock->surface = share->own_surface;
+    clock->renderer = share->own_renderer;
+  }
+  for (int i = 0; i < FRAME_SHARE_SLOTS; i++) {
+    SDL_DestroyRenderer(share->renderers[i]);
+    SDL_DestroySurface(share->surfaces[i]);
+  }
+  munmap(share->header, share->size);
+  close(share->fd);
+  shm_unlink(share->name);
+  share->header = NULL;
+}
+
+Uint16 pack_rgb565(SDL_Color color) {
+  return (Uint16)(((color.r >> 3) << 11) | ((color.g >> 2) << 5) |
+                  (color.b >> 3));
+}
+
+// Gives an index8 surface a palette of exactly the face's colors,
+// background first. The unused entries repeat the background; SDL picks
+// the first exact match, so the rasterizer only ever writes indices below
+// palette_size.
+int set_face_palette(Clock *clock, SDL_Surface *surface) {
+  const DisplayList *list = &clock->display_list;
+  SDL_Color colors[256];
+  int count = 0;
+
+  colors[count++] = (SDL_Color){list->background.r, list->background.g,
+                                list->background.b, 255};
+  for (int i = 0; i < list->op_count && count < 256; i++) {
+    SDL_Color color = {list->ops[i].color.r, list->ops[i].color.g,
+                       list->ops[i].color.b, 255};
+    int known = 0;
+    for (int j = 0; j < count && !known; j++) {
+      known = colors[j].r == color.r && colors[j].g == color.g &&
+              colors[j].b == color.b;
+    }
+    if (!known) {
+      colors[count++] = color;
+    }
+  }
+  for (int i = 0; i < count; i++) {
+    clock->palette565[i] = pack_rgb565(colors[i]);
+  }
+  clock->palette_size = count;
+  for (int i = count; i < 256; i++) {
+    colors[i] = colors[0];
+  }
+
+  SDL_Palette *palette = SDL_CreateSurfacePalette(surface);
+  return palette != NULL && SDL_SetPaletteColors(palette, colors, 0, 256);
+}
+
+// Expands palette indices to RGB565 sixteen at a time with a byte shuffle
+// per output byte; needs a palette of at most 16 entries. Returns how many
+// pixels it converted.
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("ssse3"))) int
+expand_index8_simd(const Uint8 *src, Uint16 *dst, int count,
+                   const Uint8 *low_bytes, const Uint8 *high_bytes) {
+  __m128i low_table = _mm_loadu_si128((const __m128i *)low_bytes);
+  __m128i high_table = _mm_loadu_si128((const __m128i *)high_bytes);
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i index = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128i low = _mm_shuffle_epi8(low_table, index);
+    __m128i high = _mm_shuffle_epi8(high_table, index);
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi8(low, high));
+    _mm_storeu_si128((__m128i *)(dst + i + 8), _mm_unpackhi_epi8(low, high));
+  }
+  return i;
+}
+#elif defined(__aarch64__)
+int expand_index8_simd(const Uint8 *src, Uint16 *dst, int count,
+                       const Uint8 *low_bytes, const Uint8 *high_bytes) {
+  uint8x16_t low_table = vld1q_u8(low_bytes);
+  uint8x16_t high_table = vld1q_u8(high_bytes);
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    uint8x16_t index = vld1q_u8(src + i);
+    uint8x16x2_t pixels = {{vqtbl1q_u8(low_table, index),
+                            vqtbl1q_u8(high_table, index)}};
+    vst2q_u8((uint8_t *)(dst + i), pixels);
+  }
+  return i;
+}
+#endif
+
+int have_simd_expand(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_cpu_supports("ssse3");
+#elif defined(__aarch64__)
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+void expand_index8(const Clock *clock, const Uint8 *src, Uint16 *dst,
+                   int count) {
+  static int simd = -1;
+  if (simd < 0) {
+    simd = have_simd_expand();
+  }
+
+  int i = 0;
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+  if (simd && clock->palette_size <= 16) {
+    Uint8 low_bytes[16] = {0}, high_bytes[16] = {0};
+    for (int j = 0; j < clock->palette_size; j++) {
+      low_bytes[j] = (Uint8)clock->palette565[j];
+      high_bytes[j] = (Uint8)(clock->palette565[j] >> 8);
+    }
+    i = expand_index8_simd(src, dst, count, low_bytes, high_bytes);
+  }
+#endif
+  for (; i < count; i++) {
+    dst[i] = clock->palette565[src[i]];
+  }
+}
+
+// Rasterizes into a surface of the requested format with the software
+// renderer and streams it to the window. Index8 frames are expanded to
+// RGB565 on upload since few GPU renderers take palettized textures.
+int init_stream(Clock *clock) {
+  SDL_PixelFormat format = clock->options.pixel_format;
+  int width = (int)(WINDOW_WIDTH * clock->scale_factor);
+  int height = (int)(WINDOW_HEIGHT * clock->scale_factor);
+
+  clock->surface = SDL_CreateSurface(width, height, format);
+  if (clock->surface == NULL ||
+      (format == SDL_PIXELFORMAT_INDEX8 &&
+       !set_face_palette(clock, clock->surface))) {
+    fprintf(stderr, "Surface creation failed: %s\n", SDL_GetError());
+    return 0;
+  }
+  SDL_Renderer *software = SDL_CreateSoftwareRenderer(clock->surface);
+  clock->stream = SDL_CreateTexture(
+      clock->renderer,
+      format == SDL_PIXELFORMAT_INDEX8 ? SDL_PIXELFORMAT_RGB565 : format,
+      SDL_TEXTUREACCESS_STREAMING, width, height);
+  if (software == NULL || clock->stream == NULL) {
+    fprintf(stderr, "Streaming setup failed: %s\n", SDL_GetError());
+    SDL_DestroyRenderer(software);
+    return 0;
+  }
+  clock->window_renderer = clock->renderer;
+  clock->renderer = software;
+  return 1;
+}
+
+void present_stream(Clock *clock) {
+  SDL_Surface *surface = clock->surface;
+  if (surface->format == SDL_PIXELFORMAT_INDEX8) {
+    void *pixels;
+    int pitch;
+    if (SDL_LockTexture(clock->stream, NULL, &pixels, &pitch)) {
+      for (int y = 0; y < surface->h; y++) {
+        const Uint8 *src = (const Uint8 *)surface->pixels + y * surface->pitch;
+        expand_index8(clock, src, (Uint16 *)((Uint8 *)pixels + y * pitch),
+                      surface->w);
+      }
+      SDL_UnlockTexture(clock->stream);
+    }
+  } else {
+    SDL_UpdateTexture(clock->stream, NULL, surface->pixels, surface->pitch);
+  }
+  SDL_RenderTexture(clock->window_renderer, clock->stream, NULL, NULL);
+  SDL_RenderPresent(clock->window_renderer);
+}
+
+// The readback is the only part of a screenshot the main loop waits for.
+void capture_screenshot(Clock *clock) {
+  Uint64 readback_start = monotonic_ns();
+  SDL_Surface *frame = SDL_RenderReadPixels(clock->renderer, NULL);
+  Uint64 stall_ns = monotonic_ns() - readback_start;
+  Uint64 requested_ns = clock->screenshot_requested_ns;
+  clock->screenshot_requested_ns = 0;
+
+  if (frame != NULL) {
+    queue_screenshot(&clock->screenshots, frame, requested_ns, stall_ns);
+  }
+}
+
+// Displays picked by --displays, in SDL's order. Returns how many of them
+// are attached.
+int selected_displays(Uint32 mask, SDL_DisplayID *ids) {
+  int attached = 0, count = 0;
+  SDL_DisplayID *displays = SDL_GetDisplays(&attached);
+  for (int i = 0; displays != NULL && i < attached && i < MAX_DISPLAYS; i++) {
+    if (mask & (1u << i)) {
+      ids[count++] = displays[i];
+    }
+  }
+  SDL_free(displays);
+  return count;
+}
+
+void close_display(DisplayContext *display) {
+  for (int i = 0; i < DISPLAY_BUFFERS; i++) {
+    SDL_DestroyRenderer(display->software[i]);
+    SDL_DestroySurface(display->surfaces[i]);
+  }
+  DisplayList *pending = SDL_SetAtomicPointer(&display->pending, NULL);
+  if (pending != NULL) {
+    free_display_list(pending);
+    free(pending);
+  }
+  free_display_list(&display->display_list);
+  SDL_DestroyTexture(display->texture);
+  SDL_DestroyRenderer(display->renderer);
+  if (display->window != NULL) {
+    SDL_DestroyWindow(display->window);
+  }
+}
+
+// The display's scale factor picks its own cached face.
+int open_display(const Options *options, DisplayContext *display,
+                 SDL_DisplayID id) {
+  display->id = id;
+  display->ready = -1;
+  display->uploading = -1;
+  display->window =
+      SDL_CreateWindow("Analogue Clock", WINDOW_WIDTH, WINDOW_HEIGHT,
+                       SDL_WINDOW_HIGH_PIXEL_DENSITY);
+  if (display->window == NULL) {
+    return 0;
+  }
+  SDL_SetWindowPosition(display->window, SDL_WINDOWPOS_CENTERED_DISPLAY(id),
+                        SDL_WINDOWPOS_CENTERED_DISPLAY(id));
+  display->scale_factor = SDL_GetWindowPixelDensity(display->window);
+  const SDL_DisplayMode *mode = SDL_GetCurrentDisplayMode(id);
+  if (mode != NULL && mode->refresh_rate > 0) {
+    display->refresh_ns = (Uint64)(1e9 / mode->refresh_rate);
+  }
+  display->renderer = SDL_CreateRenderer(display->window, NULL);
+  if (display->renderer == NULL ||
+      !load_display_list(options, display->scale_factor,
+                         &display->display_list)) {
+    return 0;
+  }
+  // Flips follow this display's refresh; present_displays paces itself to
+  // it so a present never waits for one
+  SDL_SetRenderVSync(display->renderer, 1);
+
+  // start_displays refuses index8 here: its palette expansion is per clock
+  SDL_PixelFormat format = options->pixel_format ? options->pixel_format
+                                                 : SDL_PIXELFORMAT_XRGB8888;
+  int width = (int)(WINDOW_WIDTH * display->scale_factor);
+  int height = (int)(WINDOW_HEIGHT * display->scale_factor);
+  display->texture = SDL_CreateTexture(display->renderer, format,
+                                       SDL_TEXTUREACCESS_STREAMING, width,
+                                       height);
+  if (display->texture == NULL) {
+    return 0;
+  }
+  for (int i = 0; i < DISPLAY_BUFFERS; i++) {
+    display->surfaces[i] = SDL_CreateSurface(width, height, format);
+    if (display->surfaces[i] == NULL) {
+      return 0;
+    }
+    display->software[i] = SDL_CreateSoftwareRenderer(display->surfaces[i]);
+    if (display->software[i] == NULL) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Draws the newest tick into whichever surface is neither waiting to be
+// presented nor being uploaded. Ticks that arrive while drawing are
+// skipped, not queued.
+int display_thread(void *data) {
+  DisplayContext *display = data;
+  DisplaySet *set = display->set;
+
+  SDL_LockMutex(set->lock);
+  for (;;) {
+    while (set->tick == display->started_tick && !set->stop) {
+      SDL_WaitCondition(set->tick_ready, set->lock);
+    }
+    if (set->stop) {
+      break;
+    }
+    if (display->started_tick != 0) {
+      display->skipped += set->tick - display->started_tick - 1;
+    }
+    display->started_tick = set->tick;
+    Pose pose = set->pose;
+    int buffer = 0;
+    while (buffer == display->ready || buffer == display->uploading) {
+      buffer++;
+    }
+    SDL_UnlockMutex(set->lock);
+
+    DisplayList *reloaded = SDL_SetAtomicPointer(&display->pending, NULL);
+    if (reloaded != NULL) {
+      free_display_list(&display->display_list);
+      display->display_list = *reloaded;
+      free(reloaded);
+    }
+    render_display_list(display->software[buffer], &display->display_list,
+                        &pose);
+    SDL_FlushRenderer(display->software[buffer]);
+
+    SDL_LockMutex(set->lock);
+    display->ready = buffer;
+    display->finished_tick = display->started_tick;
+    SDL_BroadcastCondition(set->frame_ready);
+  }
+  SDL_UnlockMutex(set->lock);
+  return 0;
+}
+
+// Opens a window on every selected display after the first, which the
+// main window already occupies, and starts their threads.
+int start_displays(Clock *clock) {
+  DisplaySet *set = &clock->displays;
+  SDL_DisplayID ids[MAX_DISPLAYS];
+  int selected = selected_displays(clock->options.display_mask, ids);
+  if (selected == 0) {
+    log_message(LOG_ERROR, "None of the --displays are attached");
+    return 0;
+  }
+  // Extra displays upload their own frames and have no palette to expand
+  if (selected > 1 && clock->options.pixel_format == SDL_PIXELFORMAT_INDEX8) {
+    log_message(LOG_ERROR,
+                "--pixel-format index8 can't drive more than one display");
+    return 0;
+  }
+
+  set->lock = SDL_CreateMutex();
+  set->tick_ready = SDL_CreateCondition();
+  set->frame_ready = SDL_CreateCondition();
+  if (set->lock == NULL || set->tick_ready == NULL ||
+      set->frame_ready == NULL) {
+    log_message(LOG_ERROR, "Display setup failed: %s", SDL_GetError());
+    return 0;
+  }
+  for (int i = 1; i < selected; i++) {
+    DisplayContext *display = &set->displays[set->count++];
+    display->set = set;
+    if (!open_display(&clock->options, display, ids[i])) {
+      log_message(LOG_ERROR, "Unable to open a window on display %u: %s",
+                  (unsigned)ids[i], SDL_GetError());
+      return 0;
+    }
+  }
+  for (int i = 0; i < set->count; i++) {
+    DisplayContext *display = &set->displays[i];
+    display->thread = SDL_CreateThread(display_thread, "display", display);
+    if (display->thread == NULL) {
+      log_message(LOG_ERROR, "Unable to start display thread: %s",
+                  SDL_GetError());
+      return 0;
+    }
+  }
+  clock->reloader.displays = set;
+  return 1;
+}
+
+// Safe to call on a set that was never started or only partly started.
+void stop_displays(DisplaySet *set) {
+  if (set->lock == NULL) {
+    return;
+  }
+  SDL_LockMutex(set->lock);
+  set->stop = 1;
+  SDL_BroadcastCondition(set->tick_ready);
+  SDL_UnlockMutex(set->lock);
+  for (int i = 0; i < set->count; i++) {
+    SDL_WaitThread(set->displays[i].thread, NULL);
+    close_display(&set->displays[i]);
+  }
+  SDL_DestroyCondition(set->frame_ready);
+  SDL_DestroyCondition(set->tick_ready);
+  SDL_DestroyMutex(set->lock);
+  memset(set, 0, sizeof(*set));
+}
+
+void publish_pose(DisplaySet *set, const Pose *pose) {
+  if (set->count == 0) {
+    return;
+  }
+  SDL_LockMutex(set->lock);
+  set->pose = *pose;
+  set->tick++;
+  SDL_BroadcastCondition(set->tick_ready);
+  SDL_UnlockMutex(set->lock);
+}
+
+// Whether the display may not have flipped its last frame yet, so another
+// present would block until its next refresh. A quarter period of slack
+// keeps a display at the main window's rate from losing frames to the
+// loop's jitter.
+int display_flip_pending(const DisplayContext *display, Uint64 now) {
+  return now - display->presented_ns <
+         display->refresh_ns - display->refresh_ns / 4;
+}
+
+// Presents every display's newest frame. Displays still drawing the current
+// tick get up to DISPLAY_WAIT_MS in total; one that is further behind, or
+// misses that, shows its frame on a later pass instead of holding up the
+// loop and the other displays. So does one whose last flip may be pending:
+// each display is paced by its own refresh, and a slow one never makes the
+// others wait for it.
+void present_displays(DisplaySet *set) {
+  if (set->count == 0) {
+    return;
+  }
+  Uint64 deadline = monotonic_ns() + DISPLAY_WAIT_MS * 1000000ULL;
+
+  SDL_LockMutex(set->lock);
+  for (;;) {
+    int drawing = 0;
+    for (int i = 0; i < set->count; i++) {
+      DisplayContext *display = &set->displays[i];
+      if (display->ready < 0) {
+        // Idle, or already drawing this tick
+        drawing += display->finished_tick != set->tick &&
+                   (display->started_tick == set->tick ||
+                    display->started_tick == display->finished_tick);
+        continue;
+      }
+      if (display_flip_pending(display, monotonic_ns())) {
+        continue;
+      }
+      SDL_Surface *surface = display->surfaces[display->ready];
+      display->uploading = display->ready;
+      display->ready = -1;
+      SDL_UnlockMutex(set->lock);
+
+      SDL_UpdateTexture(display->texture, NULL, surface->pixels,
+                        surface->pitch);
+      SDL_LockMutex(set->lock);
+      display->uploading = -1;
+      SDL_UnlockMutex(set->lock);
+      SDL_RenderTexture(display->renderer, display->texture, NULL, NULL);
+      SDL_RenderPresent(display->renderer);
+      display->presented_ns = monotonic_ns();
+      display->frames++;
+      SDL_LockMutex(set->lock);
+    }
+
+    Uint64 now = monotonic_ns();
+    if (drawing == 0 || now >= deadline) {
+      break;
+    }
+    SDL_WaitConditionTimeout(set->frame_ready, set->lock,
+                             (Sint32)((deadline - now + 999999) / 1000000));
+  }
+  for (int i = 0; i < set->count; i++) {
+    set->displays[i].deferred += set->displays[i].ready >= 0;
+  }
+  SDL_UnlockMutex(set->lock);
+}
+
+// Second hand offset from where it comes to rest, milliseconds after a
+// tick: a damped spring released 6 degrees short. Integrated from the tick
+// in fixed 1 ms steps, so a given point in the second always draws the
+// same angle whatever the frame rate.
+double tick_offset(int milliseconds) {
+  if (milliseconds >= TICK_SETTLE_MS) {
+    return 0;
+  }
+  double offset = -6.0, velocity = 0;
+  for (int i = 0; i < milliseconds; i++) {
+    velocity += (-TICK_STIFFNESS * offset - TICK_DAMPING * velocity) * 1e-3;
+    offset += velocity * 1e-3;
+  }
+  return offset;
+}
+
+// A station clock's second hand sweeps once round in SWISS_SWEEP_MS, waits
+// at 12, and releases the minute hand as the minute turns. A ticking hand
+// springs to each second, overshooting and settling within TICK_SETTLE_MS.
+Pose hand_pose(int motion, int hours, int minutes, int seconds,
+               int milliseconds) {
+  Pose pose;
+  pose.hour_angle = (hours * 30.0) + (minutes * 0.5);
+  if (motion == MOTION_TICK) {
+    pose.minute_angle = (minutes * 6.0) + (seconds * 0.1);
+    pose.second_angle = (seconds * 6.0) + tick_offset(milliseconds);
+    return pose;
+  }
+  if (motion == MOTION_SWISS) {
+    int into_minute_ms = seconds * 1000 + milliseconds;
+    pose.minute_angle = minutes * 6.0;
+    pose.second_angle = into_minute_ms < SWISS_SWEEP_MS
+                            ? into_minute_ms * 360.0 / SWISS_SWEEP_MS
+                            : 0;
+    return pose;
+  }
+  pose.minute_angle = (minutes * 6.0) + (seconds * 0.1);
+  pose.second_angle = (seconds * 6.0) + (milliseconds * 0.006);
+  return pose;
+}
+
+void start_present_predictor(PresentPredictor *predictor, Uint64 refresh_ns) {
+  memset(predictor, 0, sizeof(*predictor));
+  predictor->enabled = 1;
+  predictor->period_ns = refresh_ns > 0 ? refresh_ns : DEFAULT_REFRESH_NS;
+}
+
+Uint64 predict_present(PresentPredictor *predictor, Uint64 sample_ns) {
+  Uint64 ready_ns = sample_ns + predictor->submit_ns;
+  Uint64 predicted = ready_ns;
+  if (predictor->vblank_ns != 0 && ready_ns > predictor->vblank_ns) {
+    Uint64 period = (Uint64)predictor->period_ns;
+    Uint64 cycles = (ready_ns - predictor->vblank_ns + period - 1) / period;
+    predicted = predictor->vblank_ns + cycles * period;
+  }
+  predictor->predicted_ns = predicted;
+  return predicted;
+}
+
+void update_present_predictor(PresentPredictor *predictor, Uint64 sample_ns,
+                              Uint64 submit_ns, Uint64 present_ns) {
+  predictor->submit_ns +=
+      ((Sint64)(submit_ns - sample_ns) - predictor->submit_ns) / 8;
+
+  Sint64 error = (Sint64)(present_ns - predictor->predicted_ns);
+  Sint64 cycles = predictor->vblank_ns == 0
+                      ? 0
+                      : (Sint64)(predictor->predicted_ns -
+                                 predictor->vblank_ns) /
+                            predictor->period_ns;
+  if (cycles < 1 || error > predictor->period_ns / 2 ||
+      error < -predictor->period_ns / 2) {
+    predictor->slips += predictor->vblank_ns != 0;
+    predictor->vblank_ns = present_ns;
+    return;
+  }
+  predictor->period_ns += error / PLL_PERIOD_GAIN / cycles;
+  predictor->vblank_ns = predictor->predicted_ns + error / PLL_PHASE_GAIN;
+}
+
+void set_phase(Clock *clock, FramePhase phase) {
+  Watchdog *watchdog = &clock->watchdog;
+  __atomic_store_n(&watchdog->frame, clock->frame_count, __ATOMIC_RELAXED);
+  SDL_SetAtomicInt(&watchdog->phase, phase);
+  SDL_SetAtomicU32(&watchdog->heartbeat, ++watchdog->beats);
+}
+
+void render_clock(Clock *clock) {
+  Uint64 frame_start = monotonic_ns();
+  set_phase(clock, PHASE_TIME);
+
+  // Show the time the frame is expected to reach the screen
+  Sint64 lead_ns = 0;
+  if (clock->predictor.enabled) {
+    lead_ns = (Sint64)(predict_present(&clock->predictor, frame_start) -
+                       frame_start);
+  }
+
+  int hours, minutes, seconds, milliseconds;
+  clock->frame_sample_ns = frame_start;
+  if (get_current_time(clock, lead_ns, &clock->frame_time_ns, &hours,
+                       &minutes, &seconds, &milliseconds) != 0) {
+    log_message(LOG_ERROR, "Unable to get current time, skipping frame");
+    set_phase(clock, PHASE_IDLE);
+    return;
+  }
+  if (clock->share.header != NULL) {
+    begin_shared_frame(clock);
+  }
+
+  if (clock->event_log != NULL) {
+    EventLogRecord record = {.kind = EVENT_LOG_FRAME,
+                             .monotonic_ns = frame_start,
+                             .time_ns = clock->frame_time_ns};
+    fwrite(&record, sizeof(record), 1, clock->event_log);
+  }
+
+  // printf("Current time: %02d:%02d:%02d.%03d\n", hours == 0 ? 12 : hours,
+  //       minutes, seconds, milliseconds);
+  clock->frame_time_ms = floor_div(clock->frame_time_ns, 1000000);
+  Pose pose = hand_pose(clock->options.motion, hours, minutes, seconds,
+                        milliseconds);
+  publish_pose(&clock->displays, &pose);
+
+  set_phase(clock, PHASE_RENDER);
+  render_display_list(clock->renderer, &clock->display_list, &pose);
+
+  // The back buffer is undefined after presenting, so read it back first
+  if (clock->capture_requested) {
+    clock->capture_requested = 0;
+    SDL_DestroySurface(clock->capture);
+    clock->capture = SDL_RenderReadPixels(clock->renderer, NULL);
+  }
+  if (clock->screenshot_requested_ns != 0) {
+    capture_screenshot(clock);
+  }
+  SDL_Surface *readback = NULL;
+  if (clock->checksum_log != NULL && clock->surface == NULL) {
+    readback = SDL_RenderReadPixels(clock->renderer, NULL);
+  }
+
+  set_phase(clock, PHASE_PRESENT);
+  Uint64 submit_ns = monotonic_ns();
+  SDL_RenderPresent(clock->renderer);
+  if (clock->stream != NULL) {
+    present_stream(clock);
+  }
+  Uint64 presented_ns = monotonic_ns();
+  if (clock->predictor.enabled) {
+    update_present_predictor(&clock->predictor, frame_start, submit_ns,
+                             presented_ns);
+  }
+  if (clock->share.header != NULL) {
+    SDL_FlushRenderer(clock->renderer);
+    publish_shared_frame(clock, monotonic_ns());
+  }
+  if (clock->terminal.enabled) {
+    present_terminal(&clock->terminal, clock->surface,
+                     clock->display_list.background);
+  }
+  Uint64 present_ns = monotonic_ns();
+
+  record_frame(clock, frame_start, present_ns);
+  set_phase(clock, PHASE_LOG);
+
+  if (clock->pose_log != NULL) {
+    PoseRecord record = {clock->frame_time_ns,
+                         clock->frame_sample_ns,
+                         presented_ns,
+                         (float)pose.hour_angle,
+                         (float)pose.minute_angle,
+                         (float)pose.second_angle,
+                         0,
+                         clock->predictor.enabled
+                             ? frame_start + (Uint64)lead_ns
+                             : 0};
+    fwrite(&record, sizeof(record), 1, clock->pose_log);
+  }
+
+  // Headless frames are hashed straight from the render target
+  if (clock->checksum_log != NULL) {
+    log_frame_checksum(clock, readback ? readback : clock->surface);
+    SDL_DestroySurface(readback);
+  }
+  set_phase(clock, PHASE_IDLE);
+}
+
+// When the process was exec'd, on the monotonic clock. Falls back to "now"
+// where the kernel doesn't expose a start time.
+Uint64 process_start_ns(void) {
+  Uint64 now = monotonic_ns();
+#ifdef __linux__
+  FILE *file = fopen("/proc/self/stat", "r");
+  if (file == NULL) {
+    return now;
+  }
+  char stat[1024];
+  size_t length = fread(stat, 1, sizeof(stat) - 1, file);
+  fclose(file);
+  stat[length] = '\0';
+
+  // Field 22 (starttime) counts ticks since boot; skip past the command
+  // name, which may itself contain spaces or parentheses.
+  char *field = strrchr(stat, ')');
+  unsigned long long start_ticks = 0;
+  if (field == NULL ||
+      sscanf(field + 2,
+             "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d "
+             "%*d %*d %*d %*d %llu",
+             &start_ticks) != 1) {
+    return now;
+  }
+
+  struct timespec boot;
+  clock_gettime(CLOCK_BOOTTIME, &boot);
+  Uint64 boot_ns = (Uint64)boot.tv_sec * 1000000000ULL + boot.tv_nsec;
+  Uint64 start_ns = start_ticks * (1000000000ULL / sysconf(_SC_CLK_TCK));
+  if (start_ns > boot_ns || boot_ns - start_ns > now) {
+    return now;
+  }
+  return now - (boot_ns - start_ns);
+#else
+  return now;
+#endif
+}
+
+void mark_startup(Clock *clock, StartupStage stage) {
+  clock->startup_ns[stage] = monotonic_ns();
+}
+
+// Stages are listed in the order the main thread waits on them; the display
+// list is built in parallel, so its delta is negative when it was ready
+// before the renderer.
+void report_startup(const Clock *clock) {
+  const Uint64 *ns = clock->startup_ns;
+
+  for (int stage = 0; stage < STARTUP_STAGE_COUNT; stage++) {
+    double previous = stage > 0 ? (double)ns[stage - 1] : (double)ns[stage];
+    fprintf(stderr, "startup: %-14s %8.2f ms  (%+.2f ms)\n",
+            STARTUP_STAGE_NAMES[stage], ((double)ns[stage] - ns[0]) / 1e6,
+            ((double)ns[stage] - previous) / 1e6);
+  }
+}
+
+int display_list_job(void *data) {
+  DisplayListJob *job = data;
+  job->ok = load_display_list(job->options, job->scale_factor, &job->list);
+  job->finished_ns = monotonic_ns();
+  return 0;
+}
+
+// The desktop mode's pixel density is what a high-density window on the
+// primary display will get, and is known before any window exists.
+float predicted_scale_factor(void) {
+  const SDL_DisplayMode *mode =
+      SDL_GetDesktopDisplayMode(SDL_GetPrimaryDisplay());
+  return mode != NULL && mode->pixel_density > 0 ? mode->pixel_density : 1.0f;
+}
+
+void start_display_list_job(Clock *clock, DisplayListJob *job) {
+  memset(job, 0, sizeof(*job));
+  job->options = &clock->options;
+  job->scale_factor = predicted_scale_factor();
+  job->thread = SDL_CreateThread(display_list_job, "display list", job);
+  if (job->thread == NULL) {
+    display_list_job(job);
+  }
+}
+
+// Waits for the worker and rebuilds the list if the window's scale factor
+// differs from the guess. Safe to call more than once.
+int finish_display_list_job(Clock *clock, DisplayListJob *job) {
+  if (job->thread != NULL) {
+    SDL_WaitThread(job->thread, NULL);
+    job->thread = NULL;
+    clock->startup_ns[STARTUP_DISPLAY_LIST] = job->finished_ns;
+  }
+
+  if (job->ok && job->scale_factor != clock->scale_factor) {
+    free_display_list(&job->list);
+    job->scale_factor = clock->scale_factor;
+    job->ok = load_display_list(&clock->options, clock->scale_factor,
+                                &job->list);
+    mark_startup(clock, STARTUP_DISPLAY_LIST);
+  }
+  return job->ok;
+}
+
+void abandon_display_list_job(DisplayListJob *job) {
+  SDL_WaitThread(job->thread, NULL);
+  if (job->ok) {
+    free_display_list(&job->list);
+  }
+}
+
+// The probe result depends on the SDL build and the drivers it offers, so
+// both are recorded alongside the choice.
+void render_driver_fingerprint(char *text, size_t size) {
+  int length = snprintf(text, size, "sdl %d\ndrivers", SDL_GetVersion());
+
+  for (int i = 0; i < SDL_GetNumRenderDrivers(); i++) {
+    if (length > 0 && (size_t)length < size) {
+      length += snprintf(text + length, size - length, " %s",
+                         SDL_GetRenderDriver(i));
+    }
+  }
+  if (length > 0 && (size_t)length < size) {
+    snprintf(text + length, size - length, "\n");
+  }
+}
+
+int render_driver_cache_path(const Options *options, char *path,
+                             size_t size) {
+  char host[128] = "localhost";
+  gethostname(host, sizeof(host) - 1);
+
+  char name[160];
+  snprintf(name, sizeof(name), "render-driver-%s", host);
+  return cache_file_path(options, name, path, size);
+}
+
+int read_render_driver_cache(const Options *options, char *driver,
+                             size_t size) {
+  char path[600];
+  if (!render_driver_cache_path(options, path, sizeof(path))) {
+    return 0;
+  }
+
+  char *text = read_file(path, NULL);
+  if (text == NULL) {
+    return 0;
+  }
+
+  char fingerprint[512];
+  render_driver_fingerprint(fingerprint, sizeof(fingerprint));
+  size_t length = strlen(fingerprint);
+  char name[64];
+  int ok = strncmp(text, fingerprint, length) == 0 &&
+           sscanf(text + length, "driver %63s", name) == 1;
+  free(text);
+
+  if (ok) {
+    snprintf(driver, size, "%s", name);
+  }
+  return ok;
+}
+
+void write_render_driver_cache(const Options *options, const char *driver) {
+  char path[600];
+  if (!render_driver_cache_path(options, path, sizeof(path))) {
+    return;
+  }
+
+  char fingerprint[512];
+  render_driver_fingerprint(fingerprint, sizeof(fingerprint));
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    return;
+  }
+  fprintf(file, "%sdriver %s\n", fingerprint, driver);
+  fclose(file);
+}
+
+// Times a short burst of frames on every available driver with vsync off
+// and writes the name of the fastest into best.
+int probe_render_drivers(SDL_Window *window, const DisplayList *list,
+                         char *best, size_t size) {
+  double best_ms = 0;
+
+  for (int i = 0; i < SDL_GetNumRenderDrivers(); i++) {
+    const char *name = SDL_GetRenderDriver(i);
+    SDL_Renderer *renderer = SDL_CreateRenderer(window, name);
+    if (renderer == NULL) {
+      continue;
+    }
+    SDL_SetRenderVSync(renderer, 0);
+
+    Uint64 start = 0;
+    const int frames = RENDER_PROBE_WARMUP + RENDER_PROBE_FRAMES;
+    for (int frame = 0; frame < frames; frame++) {
+      if (frame == RENDER_PROBE_WARMUP) {
+        start = SDL_GetTicksNS();
+      }
+      Pose pose = {frame * 0.5, frame * 6.0, frame * 36.0};
+      render_display_list(renderer, list, &pose);
+
+      // Reading a pixel back waits for the GPU to finish the burst
+      if (frame == frames - 1) {
+        SDL_Rect pixel = {0, 0, 1, 1};
+        SDL_DestroySurface(SDL_RenderReadPixels(renderer, &pixel));
+      }
+      SDL_RenderPresent(renderer);
+    }
+    double ms = (SDL_GetTicksNS() - start) / 1e6 / RENDER_PROBE_FRAMES;
+    SDL_DestroyRenderer(renderer);
+
+    fprintf(stderr, "render driver %-12s %.3f ms/frame\n", name, ms);
+    if (best[0] == '\0' || ms < best_ms) {
+      snprintf(best, size, "%s", name);
+      best_ms = ms;
+    }
+  }
+
+  return best[0] != '\0';
+}
+
+// A forced driver is used as given ("default" leaves the choice to SDL).
+// Otherwise the cached probe result is used, probing first if there is
+// none; probing draws the face, so it waits for the display list.
+const char *choose_render_driver(Clock *clock, DisplayListJob *job,
+                                 char *driver, size_t size) {
+  const char *forced = clock->options.render_driver;
+  if (forced != NULL && strcmp(forced, "auto") != 0) {
+    return strcmp(forced, "default") == 0 ? NULL : forced;
+  }
+
+  driver[0] = '\0';
+  if (read_render_driver_cache(&clock->options, driver, size)) {
+    return driver;
+  }
+  if (finish_display_list_job(clock, job) &&
+      probe_render_drivers(clock->window, &job->list, driver, size)) {
+    write_render_driver_cache(&clock->options, driver);
+    return driver;
+  }
+  return NULL;
+}
+
+int init_clock(Clock *clock) {
+  if (!SDL_Init(SDL_INIT_VIDEO)) {
+    log_message(LOG_ERROR, "SDL initialization failed: %s", SDL_GetError());
+    return 0;
+  }
+  mark_startup(clock, STARTUP_SDL_INIT);
+
+  // Window and renderer creation dominate startup; compile or map the face
+  // alongside them
+  DisplayListJob job;
+  start_display_list_job(clock, &job);
+
+  clock->window =
+      SDL_CreateWindow("Analogue Clock", WINDOW_WIDTH, WINDOW_HEIGHT,
+                       SDL_WINDOW_HIGH_PIXEL_DENSITY);
+
+  if (!clock->window) {
+    log_message(LOG_ERROR, "Window creation failed: %s", SDL_GetError());
+    abandon_display_list_job(&job);
+    SDL_Quit();
+    return 0;
+  }
+  mark_startup(clock, STARTUP_WINDOW);
+
+  SDL_DisplayID ids[MAX_DISPLAYS];
+  if (clock->options.display_mask != 0 &&
+      selected_displays(clock->options.display_mask, ids) > 0) {
+    SDL_SetWindowPosition(clock->window,
+                          SDL_WINDOWPOS_CENTERED_DISPLAY(ids[0]),
+                          SDL_WINDOWPOS_CENTERED_DISPLAY(ids[0]));
+  }
+  clock->scale_factor = SDL_GetWindowPixelDensity(clock->window);
+  const SDL_DisplayMode *mode =
+      SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(clock->window));
+  if (mode != NULL && mode->refresh_rate > 0) {
+    clock->refresh_ns = (Uint64)(1e9 / mode->refresh_rate);
+  }
+  clock->running = 1;
+
+  char probed[64];
+  const char *driver =
+      choose_render_driver(clock, &job, probed, sizeof(probed));
+  clock->renderer = SDL_CreateRenderer(clock->window, driver);
+  if (!clock->renderer && driver == probed) {
+    // The cached driver may have stopped working; let SDL choose
+    clock->renderer = SDL_CreateRenderer(clock->window, NULL);
+  }
+
+  if (!clock->renderer) {
+    log_message(LOG_ERROR, "Renderer creation failed: %s", SDL_GetError());
+    abandon_display_list_job(&job);
+    SDL_DestroyWindow(clock->window);
+    SDL_Quit();
+    return 0;
+  }
+  mark_startup(clock, STARTUP_RENDERER);
+
+  if (!finish_display_list_job(clock, &job)) {
+    log_message(LOG_ERROR, "Face setup failed");
+    SDL_DestroyRenderer(clock->renderer);
+    SDL_DestroyWindow(clock->window);
+    SDL_Quit();
+    return 0;
+  }
+  clock->display_list = job.list;
+
+  return 1;
+}
+
+void sample_soak(SoakMonitor *soak, const Clock *clock) {
+  SoakSample *sample = &soak->samples[soak->count++];
+  memset(sample, 0, sizeof(*sample));
+
+#ifdef __linux__
+  FILE *statm = fopen("/proc/self/statm", "r");
+  long pages = 0, resident = 0;
+  if (statm != NULL) {
+    if (fscanf(statm, "%ld %ld", &pages, &resident) == 2) {
+      sample->rss_kb = resident * (sysconf(_SC_PAGESIZE) / 1024.0);
+    }
+    fclose(statm);
+  }
+#endif
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  sample->heap_kb = mallinfo2().uordblks / 1024.0;
+#endif
+  sample->sdl_allocations = SDL_GetNumAllocations();
+  sample->frame_us = soak->frames ? soak->frame_ns / 1e3 / soak->frames : 0;
+  soak->frames = 0;
+  soak->frame_ns = 0;
+
+  char day[64];
+  format_time_ms(clock->frame_time_ms, day, sizeof(day));
+  log_message(LOG_INFO,
+              "soak day %3d  %.10s  rss %8.0f KiB  heap %8.0f KiB  "
+              "sdl allocs %6.0f  frame %7.1f us",
+              soak->count - 1, day, sample->rss_kb, sample->heap_kb,
+              sample->sdl_allocations, sample->frame_us);
+}
+
+// Called after every frame; samples at each simulated midnight and notes
+// the calendar edge cases the run went through.
+void update_soak(SoakMonitor *soak, const Clock *clock) {
+  soak->frames++;
+  soak->frame_ns +=
+      clock->stats.samples[(clock->frame_count - 1) % FRAME_HISTORY].frame_ns;
+
+  Sint64 shown = clock->frame_time_ms;
+  time_t seconds = (time_t)(shown / 1000);
+  struct tm tm;
+  localtime_r(&seconds, &tm);
+
+  if (soak->count == 0) {
+    soak->last_isdst = tm.tm_isdst;
+  } else if (tm.tm_isdst != soak->last_isdst) {
+    soak->dst_transitions++;
+    soak->last_isdst = tm.tm_isdst;
+  }
+
+  if (shown < soak->next_sample_ms || soak->count > MAX_SOAK_DAYS) {
+    return;
+  }
+  if (tm.tm_mon == 1 && tm.tm_mday == 29) {
+    soak->leap_days++;
+  }
+  sample_soak(soak, clock);
+
+  // Next local midnight; mktime copes with 23- and 25-hour days
+  tm.tm_mday++;
+  tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+  tm.tm_isdst = -1;
+  soak->next_sample_ms = (Sint64)mktime(&tm) * 1000;
+}
+
+double soak_value(const SoakMonitor *soak, int day, size_t offset) {
+  return *(const double *)((const char *)&soak->samples[day] + offset);
+}
+
+// A metric leaks if, after warm-up, it never went down and ended more than
+// margin above where it started. Step-wise growth counts as much as daily
+// growth.
+int soak_metric_grows(const SoakMonitor *soak, size_t offset, double margin) {
+  if (soak->count < SOAK_WARMUP_DAYS + 4) {
+    return 0;
+  }
+  for (int i = SOAK_WARMUP_DAYS + 1; i < soak->count; i++) {
+    if (soak_value(soak, i, offset) < soak_value(soak, i - 1, offset)) {
+      return 0;
+    }
+  }
+  return soak_value(soak, soak->count - 1, offset) >
+         soak_value(soak, SOAK_WARMUP_DAYS, offset) + margin;
+}
+
+int finish_soak(const SoakMonitor *soak) {
+  // Margins absorb a page or so of allocator and stdio noise
+  static const struct {
+    const char *name;
+    size_t offset;
+    double margin;
+  } metrics[] = {
+      {"rss", offsetof(SoakSample, rss_kb), 8},
+      {"heap", offsetof(SoakSample, heap_kb), 8},
+      {"sdl allocations", offsetof(SoakSample, sdl_allocations), 0},
+      {"frame time", offsetof(SoakSample, frame_us), 5},
+  };
+  int ok = 1;
+
+  fprintf(stderr, "soak: %d days, %d DST transitions, %d leap days\n",
+          soak->count - 1, soak->dst_transitions, soak->leap_days);
+  for (size_t i = 0; i < sizeof(metrics) / sizeof(metrics[0]); i++) {
+    if (soak_metric_grows(soak, metrics[i].offset, metrics[i].margin)) {
+      fprintf(stderr, "soak: FAIL %s kept growing\n", metrics[i].name);
+      ok = 0;
+    }
+  }
+
+  // Frame time is noisy day to day; compare the ends of the run instead
+  int tail = (soak->count - SOAK_WARMUP_DAYS) / 10;
+  if (tail > 0) {
+    double first = 0, last = 0;
+    for (int i = 0; i < tail; i++) {
+      first += soak->samples[SOAK_WARMUP_DAYS + i].frame_us;
+      last += soak->samples[soak->count - 1 - i].frame_us;
+    }
+    if (last > first * 1.25) {
+      fprintf(stderr, "soak: FAIL frame time drifted from %.1f to %.1f us\n",
+              first / tail, last / tail);
+      ok = 0;
+    }
+  }
+
+  fprintf(stderr, "soak: %s\n", ok ? "PASS" : "FAIL");
+  return ok;
+}
+
+// Renders with SDL's software renderer into a plain surface: no video
+// subsystem, window or GPU, so output depends only on the face and time.
+int init_headless_clock(Clock *clock) {
+  if (!SDL_Init(0)) {
+    log_message(LOG_ERROR, "SDL initialization failed: %s", SDL_GetError());
+    return 0;
+  }
+  mark_startup(clock, STARTUP_SDL_INIT);
+
+  clock->scale_factor = clock->options.scale > 0 ? clock->options.scale : 1;
+  SDL_PixelFormat format = clock->options.pixel_format
+                               ? clock->options.pixel_format
+                               : SDL_PIXELFORMAT_XRGB8888;
+  clock->surface = SDL_CreateSurface((int)(WINDOW_WIDTH * clock->scale_factor),
+                                     (int)(WINDOW_HEIGHT * clock->scale_factor),
+                                     format);
+  if (!clock->surface) {
+    log_message(LOG_ERROR, "Surface creation failed: %s", SDL_GetError());
+    SDL_Quit();
+    return 0;
+  }
+  mark_startup(clock, STARTUP_WINDOW);
+
+  clock->renderer = SDL_CreateSoftwareRenderer(clock->surface);
+  if (!clock->renderer) {
+    log_message(LOG_ERROR, "Renderer creation failed: %s", SDL_GetError());
+    SDL_DestroySurface(clock->surface);
+    SDL_Quit();
+    return 0;
+  }
+  mark_startup(clock, STARTUP_RENDERER);
+
+  if (!load_display_list(&clock->options, clock->scale_factor,
+                         &clock->display_list)) {
+    log_message(LOG_ERROR, "Face setup failed");
+    SDL_DestroyRenderer(clock->renderer);
+    SDL_DestroySurface(clock->surface);
+    SDL_Quit();
+    return 0;
+  }
+  mark_startup(clock, STARTUP_DISPLAY_LIST);
+  if (format == SDL_PIXELFORMAT_INDEX8 &&
+      !set_face_palette(clock, clock->surface)) {
+    log_message(LOG_ERROR, "Palette setup failed: %s", SDL_GetError());
+    free_display_list(&clock->display_list);
+    SDL_DestroyRenderer(clock->renderer);
+    SDL_DestroySurface(clock->surface);
+    SDL_Quit();
+    return 0;
+  }
+  clock->running = 1;
+
+  return 1;
+}
+
+void cleanup_clock(Clock *clock) {
+  stop_displays(&clock->displays);
+  free_display_list(&clock->display_list);
+  SDL_DestroySurface(clock->capture);
+  SDL_DestroyRenderer(clock->renderer);
+  if (clock->stream != NULL) {
+    SDL_DestroyTexture(clock->stream);
+    SDL_DestroyRenderer(clock->window_renderer);
+  }
+  if (clock->window) {
+    SDL_DestroyWindow(clock->window);
+  }
+  SDL_DestroySurface(clock->surface);
+  if (clock->replay != NULL) {
+    fclose(clock->replay);
+    clock->replay = NULL;
+  }
+  SDL_Quit();
+}
+
+// Compares two images channel by channel. Differences up to tolerance are
+// accepted, to allow for anti-aliasing differences between SDL builds.
+int compare_images(SDL_Surface *actual, const char *golden_path,
+                   int tolerance) {
+  SDL_Surface *golden = SDL_LoadBMP(golden_path);
+  if (golden == NULL) {
+    fprintf(stderr, "%s: unable to load golden image (run make golden?)\n",
+            golden_path);
+    return 0;
+  }
+
+  SDL_Surface *a = SDL_ConvertSurface(actual, SDL_PIXELFORMAT_RGBA8888);
+  SDL_Surface *b = SDL_ConvertSurface(golden, SDL_PIXELFORMAT_RGBA8888);
+  SDL_DestroySurface(golden);
+  if (a == NULL || b == NULL || a->w != b->w || a->h != b->h) {
+    fprintf(stderr, "%s: size mismatch\n", golden_path);
+    SDL_DestroySurface(a);
+    SDL_DestroySurface(b);
+    return 0;
+  }
+
+  long differing = 0;
+  int worst = 0;
+  for (int y = 0; y < a->h; y++) {
+    const Uint32 *row_a =
+        (const Uint32 *)((const Uint8 *)a->pixels + y * a->pitch);
+    const Uint32 *row_b =
+        (const Uint32 *)((const Uint8 *)b->pixels + y * b->pitch);
+    for (int x = 0; x < a->w; x++) {
+      // Alpha is ignored; BMP round trips don't preserve it
+      int pixel_worst = 0;
+      for (int shift = 8; shift < 32; shift += 8) {
+        int diff = abs((int)((row_a[x] >> shift) & 0xff) -
+                       (int)((row_b[x] >> shift) & 0xff));
+        if (diff > pixel_worst) {
+          pixel_worst = diff;
+        }
+      }
+      if (pixel_worst > tolerance) {
+        differing++;
+      }
+      if (pixel_worst > worst) {
+        worst = pixel_worst;
+      }
+    }
+  }
+  SDL_DestroySurface(a);
+  SDL_DestroySurface(b);
+
+  if (differing > 0) {
+    fprintf(stderr, "%s: %ld pixels differ (max channel difference %d)\n",
+            golden_path, differing, worst);
+    return 0;
+  }
+  return 1;
+}
+
+// Records are appended through a large stdio buffer, so a frame costs a
+// memcpy and the file sees one write per few thousand frames.
+int open_pose_log(Clock *clock, const char *path) {
+  clock->pose_log = fopen(path, "wb");
+  if (clock->pose_log == NULL) {
+    fprintf(stderr, "Unable to open %s\n", path);
+    return 0;
+  }
+  setvbuf(clock->pose_log, NULL, _IOFBF, 1 << 18);
+
+  Uint32 flags = 0;
+  if (clock->options.virtual_time) {
+    flags |= POSE_LOG_VIRTUAL_TIME;
+  }
+  if (clock->options.motion == MOTION_SWISS) {
+    flags |= POSE_LOG_STOP_TO_GO;
+  } else if (clock->options.motion == MOTION_TICK) {
+    flags |= POSE_LOG_TICK;
+  }
+  PoseLogHeader header = {POSE_LOG_MAGIC, POSE_LOG_VERSION,
+                          sizeof(PoseRecord), flags};
+  fwrite(&header, sizeof(header), 1, clock->pose_log);
+  return 1;
+}
+
+// Unlike face_source_hash, depends only on the face's text, so a log
+// recorded on one machine can be checked against the face on another.
+int face_text_hash(const char *path, Uint64 *hash) {
+  *hash = 0xcbf29ce484222325ULL;
+  if (path == NULL) {
+    *hash = hash_bytes(*hash, DEFAULT_FACE, sizeof(DEFAULT_FACE));
+    return 1;
+  }
+  size_t size;
+  char *text = read_file(path, &size);
+  if (text == NULL) {
+    return 0;
+  }
+  *hash = hash_bytes(*hash, text, size);
+  free(text);
+  return 1;
+}
+
+int open_event_log(Clock *clock, const char *path) {
+  const Options *options = &clock->options;
+  EventLogHeader header = {.magic = EVENT_LOG_MAGIC,
+                           .version = EVENT_LOG_VERSION,
+                           .record_size = sizeof(EventLogRecord),
+                           .scale_factor = clock->scale_factor,
+                           .motion = (Uint32)options->motion,
+                           .pixel_format = options->pixel_format};
+  if (!face_text_hash(options->face_path, &header.face_hash)) {
+    fprintf(stderr, "Unable to read face %s\n", options->face_path);
+    return 0;
+  }
+  if (options->face_path != NULL) {
+    if (strlen(options->face_path) >= sizeof(header.face_path)) {
+      fprintf(stderr, "Face path too long to record: %s\n",
+              options->face_path);
+      return 0;
+    }
+    strcpy(header.face_path, options->face_path);
+  }
+  const char *tz = getenv("TZ");
+  if (tz != NULL) {
+    snprintf(header.tz, sizeof(header.tz), "%s", tz);
+  }
+
+  clock->event_log = fopen(path, "wb");
+  if (clock->event_log == NULL) {
+    fprintf(stderr, "Unable to open %s\n", path);
+    return 0;
+  }
+  setvbuf(clock->event_log, NULL, _IOFBF, 1 << 18);
+  fwrite(&header, sizeof(header), 1, clock->event_log);
+  return 1;
+}
+
+// Replays render headlessly with the recorded scale, motion, pixel format,
+// face and time zone. Options left at their defaults take the recorded
+// values; ones set differently are refused, since the frames would differ.
+int open_replay(Clock *clock, const char *path) {
+  clock->replay = fopen(path, "rb");
+  if (clock->replay == NULL) {
+    fprintf(stderr, "Unable to open %s\n", path);
+    return 0;
+  }
+
+  EventLogHeader header;
+  if (fread(&header, sizeof(header), 1, clock->replay) != 1 ||
+      header.magic != EVENT_LOG_MAGIC ||
+      header.version != EVENT_LOG_VERSION ||
+      header.record_size != sizeof(EventLogRecord)) {
+    fprintf(stderr, "%s: not a version %d event log from this build\n", path,
+            EVENT_LOG_VERSION);
+    fclose(clock->replay);
+    clock->replay = NULL;
+    return 0;
+  }
+  header.face_path[sizeof(header.face_path) - 1] = '\0';
+  header.tz[sizeof(header.tz) - 1] = '\0';
+
+  Options *options = &clock->options;
+  const char *mismatch = NULL;
+  if (options->scale == 0 && header.scale_factor > 0) {
+    options->scale = header.scale_factor;
+  }
+  if (options->motion == MOTION_SWEEP) {
+    options->motion = (int)header.motion;
+  } else if (options->motion != (int)header.motion) {
+    mismatch = "--motion";
+  }
+  if (options->pixel_format == 0) {
+    options->pixel_format = header.pixel_format;
+  } else if (options->pixel_format != header.pixel_format) {
+    mismatch = "--pixel-format";
+  }
+  if (options->face_path == NULL && header.face_path[0] != '\0') {
+    snprintf(clock->replay_face_path, sizeof(clock->replay_face_path), "%s",
+             header.face_path);
+    options->face_path = clock->replay_face_path;
+  }
+  Uint64 face_hash;
+  if (mismatch == NULL && (!face_text_hash(options->face_path, &face_hash) ||
+                           face_hash != header.face_hash)) {
+    mismatch = "the face";
+  }
+  if (mismatch != NULL) {
+    fprintf(stderr, "%s: %s doesn't match the recording\n", path, mismatch);
+    fclose(clock->replay);
+    clock->replay = NULL;
+    return 0;
+  }
+
+  if (header.tz[0] != '\0') {
+    setenv("TZ", header.tz, 1);
+  } else {
+    unsetenv("TZ");
+  }
+  tzset();
+  return 1;
+}
+
+int compare_ns(const void *a, const void *b) {
+  Uint64 x = *(const Uint64 *)a;
+  Uint64 y = *(const Uint64 *)b;
+  return (x > y) - (x < y);
+}
+
+typedef struct {
+  double p50;
+  double p90;
+  double p99;
+  double max;
+  double mean;
+} Percentiles;
+
+// Sorts values in place; results are in milliseconds.
+Percentiles percentiles_ms(Uint64 *values, int count) {
+  Percentiles result = {0};
+  if (count == 0) {
+    return result;
+  }
+  qsort(values, count, sizeof(Uint64), compare_ns);
+
+  double total = 0;
+  for (int i = 0; i < count; i++) {
+    total += values[i];
+  }
+  result.p50 = values[count / 2] / 1e6;
+  result.p90 = values[count * 90 / 100] / 1e6;
+  result.p99 = values[count * 99 / 100] / 1e6;
+  result.max = values[count - 1] / 1e6;
+  result.mean = total / count / 1e6;
+  return result;
+}
+
+// Summarizes the frame-time ring. Returns the median in microseconds.
+double report_frame_times(Clock *clock) {
+  static FrameSample samples[FRAME_HISTORY];
+  static Uint64 values[FRAME_HISTORY];
+  int count = copy_frame_samples(&clock->stats, samples, FRAME_HISTORY, NULL);
+  if (count == 0) {
+    return 0;
+  }
+
+  for (int i = 0; i < count; i++) {
+    values[i] = samples[i].frame_ns;
+  }
+  Percentiles frame = percentiles_ms(values, count);
+  fprintf(stderr,
+          "frames %d  mean %.1f us  p50 %.1f us  p90 %.1f us  p99 %.1f us  "
+          "max %.1f us\n",
+          count, frame.mean * 1e3, frame.p50 * 1e3, frame.p90 * 1e3,
+          frame.p99 * 1e3, frame.max * 1e3);
+
+  if (clock->surface != NULL) {
+    SDL_Surface *surface = clock->surface;
+    size_t full = (size_t)surface->w * surface->h * 4;
+    size_t rasterized = (size_t)surface->pitch * surface->h;
+    size_t uploaded = clock->stream == NULL ? 0
+                      : surface->format == SDL_PIXELFORMAT_XRGB8888
+                          ? full
+                          : full / 2;
+    fprintf(stderr,
+            "pixel format %s: %zu bytes/frame rasterized (%.0f%% of "
+            "XRGB8888)",
+            clock->options.pixel_format_name ? clock->options.pixel_format_name
+                                             : "xrgb8888",
+            rasterized, 100.0 * rasterized / full);
+    if (uploaded > 0) {
+      fprintf(stderr, ", %zu uploaded (%.0f%%)", uploaded,
+              100.0 * uploaded / full);
+    }
+    fprintf(stderr, "\n");
+  }
+
+  // Animated motions only render while the hand moves
+  if (!clock->options.headless && count > 1) {
+    double seconds = (samples[count - 1].present_ns - samples[0].present_ns) /
+                     1e9;
+    static const char *const motions[] = {"sweep", "swiss", "tick"};
+    fprintf(stderr, "%s motion: %.1f fps average over %.1f s\n",
+            motions[clock->options.motion],
+            seconds > 0 ? (count - 1) / seconds : 0, seconds);
+  }
+
+  if (clock->predictor.enabled) {
+    fprintf(stderr,
+            "present prediction: refresh period %.3f ms, %llu slipped "
+            "refreshes\n",
+            clock->predictor.period_ns / 1e6,
+            (unsigned long long)clock->predictor.slips);
+  }
+
+  for (int i = 0; i < clock->displays.count; i++) {
+    DisplayContext *display = &clock->displays.displays[i];
+    SDL_LockMutex(clock->displays.lock);
+    Uint64 skipped = display->skipped;
+    Uint64 deferred = display->deferred;
+    SDL_UnlockMutex(clock->displays.lock);
+    fprintf(stderr,
+            "display %u: %llu frames presented, %llu ticks skipped, %llu "
+            "presents deferred\n",
+            (unsigned)display->id, (unsigned long long)display->frames,
+            (unsigned long long)skipped, (unsigned long long)deferred);
+  }
+
+  // Headless runs never wait, so there's no lateness to report
+  for (int i = 0; i < count; i++) {
+    values[i] = samples[i].wake_late_ns;
+  }
+  Percentiles late = percentiles_ms(values, count);
+  if (late.max > 0) {
+    fprintf(stderr,
+            "wake late  mean %.1f us  p50 %.1f us  p90 %.1f us  p99 %.1f us  "
+            "max %.1f us\n",
+            late.mean * 1e3, late.p50 * 1e3, late.p90 * 1e3, late.p99 * 1e3,
+            late.max * 1e3);
+  }
+  return frame.p50 * 1e3;
+}
+
+// Raises the calling thread's scheduling priority and pins it to a CPU,
+// then locks the process's pages so the render loop never waits on page
+// faults. Called once warm-up is over, after the helper threads exist, so
+// they keep the default policy. Failures are reported but not fatal.
+void apply_realtime(const Options *options) {
+#ifdef __linux__
+  if (options->cpu >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(options->cpu, &cpus);
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+      log_message(LOG_WARN, "Unable to pin to CPU %d: %s", options->cpu,
+                  strerror(errno));
+    }
+  }
+  if (options->realtime == NULL) {
+    return;
+  }
+
+  // sched_setscheduler and setpriority act on the calling thread only
+  int policy = strcmp(options->realtime, "rr") == 0 ? SCHED_RR : SCHED_FIFO;
+  struct sched_param param = {.sched_priority = REALTIME_PRIORITY};
+  if (sched_setscheduler(0, policy, &param) == 0) {
+    log_message(LOG_INFO, "Scheduling render thread as SCHED_%s %d",
+                policy == SCHED_RR ? "RR" : "FIFO", REALTIME_PRIORITY);
+  } else if (setpriority(PRIO_PROCESS, 0, FALLBACK_NICENESS) == 0) {
+    log_message(LOG_WARN, "No real-time privilege; render thread nice %d",
+                FALLBACK_NICENESS);
+  } else {
+    log_message(LOG_WARN, "Unable to raise render thread priority: %s",
+                strerror(errno));
+  }
+  // Normal threads have their sleeps padded by up to 50 us of timer slack
+  prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    log_message(LOG_WARN, "Unable to lock memory: %s", strerror(errno));
+  }
+#else
+  if (options->realtime != NULL || options->cpu >= 0) {
+    log_message(LOG_WARN, "Real-time scheduling is only supported on Linux");
+  }
+#endif
+}
+
+int open_phase_sync(PhaseSync *sync, SyncRole role, const char *group,
+                    int port) {
+  sync->role = role;
+  sync->group.sin_family = AF_INET;
+  sync->group.sin_port = htons((Uint16)port);
+  if (inet_pton(AF_INET, group, &sync->group.sin_addr) != 1 ||
+      !IN_MULTICAST(ntohl(sync->group.sin_addr.s_addr))) {
+    fprintf(stderr, "%s is not a multicast address\n", group);
+    return 0;
+  }
+
+  sync->fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sync->fd < 0) {
+    fprintf(stderr, "Unable to create sync socket: %s\n", strerror(errno));
+    return 0;
+  }
+  fcntl(sync->fd, F_SETFD, FD_CLOEXEC);
+
+  if (role == SYNC_LEADER) {
+    // Loopback delivery lets followers on the same host hear the leader
+    unsigned char ttl = 1, loop = 1;
+    setsockopt(sync->fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    setsockopt(sync->fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    return 1;
+  }
+
+  // Several followers on one host share the port
+  int reuse = 1;
+  setsockopt(sync->fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#ifdef SO_REUSEPORT
+  setsockopt(sync->fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+#endif
+  struct sockaddr_in local = {0};
+  local.sin_family = AF_INET;
+  local.sin_port = sync->group.sin_port;
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  struct ip_mreq membership = {0};
+  membership.imr_multiaddr = sync->group.sin_addr;
+  membership.imr_interface.s_addr = htonl(INADDR_ANY);
+  if (bind(sync->fd, (struct sockaddr *)&local, sizeof(local)) != 0 ||
+      setsockopt(sync->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership,
+                 sizeof(membership)) != 0) {
+    fprintf(stderr, "Unable to join %s:%d: %s\n", group, port,
+            strerror(errno));
+    close(sync->fd);
+    return 0;
+  }
+  return 1;
+}
+
+void send_sync_tick(PhaseSync *sync, Uint64 tick_ns) {
+  SyncPacket packet;
+  packet.magic = htonl(SYNC_MAGIC);
+  packet.version = htonl(SYNC_VERSION);
+  packet.sequence = htonl(++sync->sequence);
+  packet.interval_ns = htonl((Uint32)FRAME_INTERVAL_NS);
+  packet.late_ns = htonl((Uint32)(monotonic_ns() - tick_ns));
+  sendto(sync->fd, &packet, sizeof(packet), 0,
+         (struct sockaddr *)&sync->group, sizeof(sync->group));
+}
+
+// Timestamps leader packets as they arrive, so the main loop's own
+// latency doesn't count as phase error.
+int phase_sync_thread(void *data) {
+  PhaseSync *sync = data;
+
+  while (!SDL_GetAtomicInt(&sync->stop)) {
+    struct pollfd fd = {sync->fd, POLLIN, 0};
+    if (poll(&fd, 1, RELOAD_POLL_MS) <= 0) {
+      continue;
+    }
+    SyncPacket packet;
+    ssize_t length = recv(sync->fd, &packet, sizeof(packet), 0);
+    Uint64 arrival_ns = monotonic_ns();
+    if (length != sizeof(packet) || ntohl(packet.magic) != SYNC_MAGIC ||
+        ntohl(packet.version) != SYNC_VERSION ||
+        ntohl(packet.interval_ns) != FRAME_INTERVAL_NS) {
+      continue;
+    }
+
+    SDL_LockMutex(sync->lock);
+    sync->leader_tick_ns = arrival_ns - ntohl(packet.late_ns);
+    sync->leader_ticks++;
+    SDL_UnlockMutex(sync->lock);
+  }
+  return 0;
+}
+
+int start_phase_sync(PhaseSync *sync) {
+  if (sync->role != SYNC_FOLLOWER) {
+    return 1;
+  }
+  sync->lock = SDL_CreateMutex();
+  if (sync->lock != NULL) {
+    sync->thread = SDL_CreateThread(phase_sync_thread, "phase sync", sync);
+  }
+  if (sync->thread == NULL) {
+    fprintf(stderr, "Unable to start phase sync: %s\n", SDL_GetError());
+    SDL_DestroyMutex(sync->lock);
+    return 0;
+  }
+  return 1;
+}
+
+// Moves the next tick onto the leader's phase. Large errors are taken out
+// at once; small ones are halved each tick to filter network jitter. The
+// tick only ever moves to a time that is still ahead.
+void follow_leader(Clock *clock, Uint64 now) {
+  PhaseSync *sync = &clock->sync;
+  SDL_LockMutex(sync->lock);
+  Uint64 leader_tick_ns = sync->leader_tick_ns;
+  Uint32 leader_ticks = sync->leader_ticks;
+  SDL_UnlockMutex(sync->lock);
+  if (leader_ticks == sync->used_ticks ||
+      now - leader_tick_ns > SYNC_STALE_NS) {
+    return;
+  }
+  sync->used_ticks = leader_ticks;
+
+  Sint64 interval = (Sint64)FRAME_INTERVAL_NS;
+  Sint64 error = ((Sint64)(clock->next_frame_ns - leader_tick_ns)) % interval;
+  if (error > interval / 2) {
+    error -= interval;
+  } else if (error <= -interval / 2) {
+    error += interval;
+  }
+  sync->errors_ms[sync->error_count++ % FRAME_HISTORY] = error / 1e6;
+
+  // A single late packet mustn't yank the phase, so a large error is only
+  // acted on when the previous tick agreed
+  int large = error > SYNC_CAPTURE_NS || error < -SYNC_CAPTURE_NS;
+  Sint64 correction = error / 2;
+  if (large) {
+    correction = sync->previous_large ? error : 0;
+  }
+  sync->previous_large = large;
+  clock->next_frame_ns -= correction;
+  if (clock->next_frame_ns <= now) {
+    clock->next_frame_ns += FRAME_INTERVAL_NS;
+  }
+}
+
+int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+// Returns a follower's p99 phase error in milliseconds, or -1 if too few
+// leader ticks were heard to measure it.
+double stop_phase_sync(PhaseSync *sync) {
+  if (sync->role == SYNC_OFF) {
+    return -1;
+  }
+  if (sync->thread != NULL) {
+    SDL_SetAtomicInt(&sync->stop, 1);
+    SDL_WaitThread(sync->thread, NULL);
+    sync->thread = NULL;
+    SDL_DestroyMutex(sync->lock);
+  }
+  close(sync->fd);
+
+  // The first ticks are spent acquiring phase and aren't representative
+  if (sync->role == SYNC_FOLLOWER && sync->error_count > 10) {
+    int count = sync->error_count < FRAME_HISTORY ? (int)sync->error_count
+                                                  : FRAME_HISTORY;
+    int first = sync->error_count <= FRAME_HISTORY ? 10 : 0;
+    static double magnitudes[FRAME_HISTORY];
+    int n = 0;
+    for (int i = first; i < count; i++) {
+      magnitudes[n++] = fabs(sync->errors_ms[i]);
+    }
+    qsort(magnitudes, n, sizeof(double), compare_doubles);
+    fprintf(stderr,
+            "sync: %llu leader ticks, |phase error| p50 %.3f ms  p90 %.3f ms  "
+            "p99 %.3f ms  max %.3f ms\n",
+            (unsigned long long)sync->error_count, magnitudes[n / 2],
+            magnitudes[n * 90 / 100], magnitudes[n * 99 / 100],
+            magnitudes[n - 1]);
+    return magnitudes[n * 99 / 100];
+  } else if (sync->role == SYNC_FOLLOWER) {
+    fprintf(stderr, "sync: heard %llu leader ticks\n",
+            (unsigned long long)sync->error_count);
+  }
+  return -1;
+}
+
+// Time from the slot just rendered to the next one. The animated motions
+// render at the display's refresh rate while the second hand moves, land a
+// frame exactly where it stops, then sleep until it moves again: through
+// the pause at 12 for stop-to-go, or to the next second for ticks.
+Uint64 frame_interval_ns(const Clock *clock) {
+  Sint64 period_ns, moving_ns;
+  if (clock->options.motion == MOTION_SWISS) {
+    period_ns = 60000000000LL;
+    moving_ns = SWISS_SWEEP_MS * 1000000LL;
+  } else if (clock->options.motion == MOTION_TICK) {
+    period_ns = 1000000000LL;
+    moving_ns = TICK_SETTLE_MS * 1000000LL;
+  } else {
+    return FRAME_INTERVAL_NS;
+  }
+
+  // The frame's time was sampled a little after its slot began
+  Sint64 slot_time_ns = clock->frame_time_ns -
+                        (Sint64)(clock->frame_sample_ns - clock->next_frame_ns);
+  Sint64 into_period =
+      slot_time_ns - floor_div(slot_time_ns, period_ns) * period_ns;
+  // The real-time and monotonic clocks drift apart by a few microseconds
+  // between frames; don't spend a frame on what's left of a stop slot
+  if (into_period + 1000000 >= moving_ns) {
+    return (Uint64)(period_ns - into_period);
+  }
+  Uint64 until_stop = (Uint64)(moving_ns - into_period);
+  Uint64 refresh_ns =
+      clock->refresh_ns > 0 ? clock->refresh_ns : DEFAULT_REFRESH_NS;
+  return until_stop < refresh_ns ? until_stop : refresh_ns;
+}
+
+// Sleeps until the next slot: on a fixed 100 ms grid, or as the hand
+// motion asks. Slots that have already passed are skipped and counted
+// rather than rendered in a burst, and the wake-up lateness goes into the
+// next frame's sample.
+void wait_for_next_frame(Clock *clock) {
+  Uint64 now = monotonic_ns();
+  if (clock->next_frame_ns == 0) {
+    clock->next_frame_ns = now;
+  }
+  Uint64 interval = frame_interval_ns(clock);
+  clock->next_frame_ns += interval;
+  if (clock->sync.role == SYNC_FOLLOWER) {
+    follow_leader(clock, now);
+  }
+
+  if (now >= clock->next_frame_ns) {
+    Uint64 missed = (now - clock->next_frame_ns) / interval + 1;
+    clock->skipped_frames += missed;
+    clock->next_frame_ns += missed * interval;
+    SDL_SetAtomicU32(&clock->stats.skipped_frames,
+                     (Uint32)clock->skipped_frames);
+  }
+
+  SDL_DelayNS(clock->next_frame_ns - now);
+  Uint64 woke = monotonic_ns();
+  clock->wake_late_ns =
+      woke > clock->next_frame_ns ? woke - clock->next_frame_ns : 0;
+  if (clock->sync.role == SYNC_LEADER) {
+    send_sync_tick(&clock->sync, clock->next_frame_ns);
+  }
+}
+
+int format_stats_json(FrameStats *stats, char *text, size_t size) {
+  static FrameSample samples[FRAME_HISTORY];
+  static Uint64 values[FRAME_HISTORY];
+  int count = copy_frame_samples(stats, samples, FRAME_HISTORY, NULL);
+  Uint64 now = monotonic_ns();
+
+  Uint64 window_ns = now - stats->start_ns;
+  if (window_ns > STATS_WINDOW_NS) {
+    window_ns = STATS_WINDOW_NS;
+  }
+  int recent = 0;
+  for (int i = 0; i < count; i++) {
+    recent += now - samples[i].present_ns <= window_ns;
+  }
+
+  for (int i = 0; i < count; i++) {
+    values[i] = samples[i].frame_ns;
+  }
+  Percentiles frame = percentiles_ms(values, count);
+  for (int i = 0; i < count; i++) {
+    values[i] = samples[i].wake_late_ns;
+  }
+  Percentiles late = percentiles_ms(values, count);
+
+  int hits = SDL_GetAtomicInt(&face_cache_hits);
+  int misses = SDL_GetAtomicInt(&face_cache_misses);
+  return snprintf(
+      text, size,
+      "{\"uptime_s\":%.1f,\"frames\":%u,\"samples\":%d,"
+      "\"presents_per_s\":%.2f,\"skipped_frames\":%u,"
+      "\"frame_ms\":{\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f},"
+      "\"wake_late_ms\":{\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,"
+      "\"max\":%.3f},"
+      "\"face_cache\":{\"hits\":%d,\"misses\":%d,\"hit_rate\":%.3f},"
+      "\"render_driver\":\"%s\"}\n",
+      (now - stats->start_ns) / 1e9, SDL_GetAtomicU32(&stats->written), count,
+      window_ns ? recent / (window_ns / 1e9) : 0.0,
+      SDL_GetAtomicU32(&stats->skipped_frames), frame.p50, frame.p90,
+      frame.p99, frame.max, late.p50, late.p90, late.p99, late.max, hits,
+      misses, hits + misses ? (double)hits / (hits + misses) : 0.0,
+      stats->render_driver ? stats->render_driver : "");
+}
+
+typedef struct {
+  int fd;
+  char response[STATS_RESPONSE_MAX];
+  size_t length;
+  size_t sent;
+  Uint64 deadline_ns;
+} StatsClient;
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Each client gets one snapshot, taken when it connects, and is then
+// closed. Slow readers are written to as their socket drains and dropped
+// after a timeout.
+int stats_server_thread(void *data) {
+  StatsServer *server = data;
+  StatsClient clients[STATS_MAX_CLIENTS];
+  int client_count = 0;
+
+  while (!SDL_GetAtomicInt(&server->stop)) {
+    struct pollfd fds[STATS_MAX_CLIENTS + 1];
+    fds[0] = (struct pollfd){server->listen_fd, POLLIN, 0};
+    for (int i = 0; i < client_count; i++) {
+      fds[i + 1] = (struct pollfd){clients[i].fd, POLLOUT, 0};
+    }
+    if (poll(fds, client_count + 1, RELOAD_POLL_MS) < 0 && errno != EINTR) {
+      break;
+    }
+
+    Uint64 now = monotonic_ns();
+    for (int i = 0; i < client_count; i++) {
+      StatsClient *client = &clients[i];
+      ssize_t sent = 0;
+      if (fds[i + 1].revents & (POLLOUT | POLLERR | POLLHUP)) {
+        sent = send(client->fd, client->response + client->sent,
+                    client->length - client->sent, MSG_NOSIGNAL);
+        if (sent > 0) {
+          client->sent += sent;
+        }
+      }
+      if (client->sent == client->length || now > client->deadline_ns ||
+          (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        close(client->fd);
+        clients[i] = clients[--client_count];
+        fds[i + 1] = fds[client_count + 1];
+        i--;
+      }
+    }
+
+    int fd;
+    while ((fd = accept(server->listen_fd, NULL, NULL)) >= 0) {
+      if (client_count == STATS_MAX_CLIENTS) {
+        close(fd);
+        continue;
+      }
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+      StatsClient *client = &clients[client_count++];
+      client->fd = fd;
+      int length = format_stats_json(server->stats, client->response,
+                                     sizeof(client->response));
+      client->length = length > 0 && (size_t)length < sizeof(client->response)
+                           ? (size_t)length
+                           : 0;
+      client->sent = 0;
+      client->deadline_ns = now + STATS_CLIENT_TIMEOUT_NS;
+    }
+  }
+
+  for (int i = 0; i < client_count; i++) {
+    close(clients[i].fd);
+  }
+  return 0;
+}
+
+int start_stats_server(StatsServer *server, const char *path,
+                       FrameStats *stats) {
+  struct sockaddr_un address = {0};
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "Stats socket path too long: %s\n", path);
+    return 0;
+  }
+  snprintf(address.sun_path, sizeof(address.sun_path), "%s", path);
+
+  server->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server->listen_fd < 0) {
+    fprintf(stderr, "Unable to create stats socket: %s\n", strerror(errno));
+    return 0;
+  }
+  fcntl(server->listen_fd, F_SETFL,
+        fcntl(server->listen_fd, F_GETFL) | O_NONBLOCK);
+  fcntl(server->listen_fd, F_SETFD, FD_CLOEXEC);
+
+  // A socket left behind by a previous run would make bind fail
+  unlink(path);
+  if (bind(server->listen_fd, (struct sockaddr *)&address, sizeof(address)) !=
+          0 ||
+      listen(server->listen_fd, STATS_MAX_CLIENTS) != 0) {
+    fprintf(stderr, "Unable to listen on %s: %s\n", path, strerror(errno));
+    close(server->listen_fd);
+    return 0;
+  }
+
+  server->path = path;
+  server->stats = stats;
+  server->thread = SDL_CreateThread(stats_server_thread, "stats", server);
+  if (server->thread == NULL) {
+    close(server->listen_fd);
+    unlink(path);
+    return 0;
+  }
+  return 1;
+}
+
+void stop_stats_server(StatsServer *server) {
+  if (server->thread == NULL) {
+    return;
+  }
+  SDL_SetAtomicInt(&server->stop, 1);
+  SDL_WaitThread(server->thread, NULL);
+  server->thread = NULL;
+  close(server->listen_fd);
+  unlink(server->path);
+}
+
+typedef struct {
+  const char *name;
+  const char *help;
+  const double *bounds; // upper bounds in seconds, ascending
+  int bound_count;
+  Uint64 buckets[MAX_HISTOGRAM_BUCKETS];
+  Uint64 count;
+  double sum;
+} Histogram;
+
+void histogram_observe(Histogram *histogram, double seconds) {
+  for (int i = 0; i < histogram->bound_count; i++) {
+    if (seconds <= histogram->bounds[i]) {
+      histogram->buckets[i]++;
+      break;
+    }
+  }
+  histogram->count++;
+  histogram->sum += seconds;
+}
+
+void write_histogram(FILE *file, const Histogram *histogram) {
+  fprintf(file, "# HELP %s %s\n# TYPE %s histogram\n", histogram->name,
+          histogram->help, histogram->name);
+  Uint64 cumulative = 0;
+  for (int i = 0; i < histogram->bound_count; i++) {
+    cumulative += histogram->buckets[i];
+    fprintf(file, "%s_bucket{le=\"%g\"} %llu\n", histogram->name,
+            histogram->bounds[i], (unsigned long long)cumulative);
+  }
+  fprintf(file, "%s_bucket{le=\"+Inf\"} %llu\n", histogram->name,
+          (unsigned long long)histogram->count);
+  fprintf(file, "%s_sum %.9f\n%s_count %llu\n", histogram->name,
+          histogram->sum, histogram->name,
+          (unsigned long long)histogram->count);
+}
+
+// Written to a temporary file and renamed over the target so the
+// collector never reads a partial file.
+int write_metrics_file(const char *path, const Histogram *histograms,
+                       int histogram_count, FrameStats *stats) {
+  char temp_path[4096];
+  if (snprintf(temp_path, sizeof(temp_path), "%s.tmp", path) >=
+      (int)sizeof(temp_path)) {
+    return 0;
+  }
+  FILE *file = fopen(temp_path, "w");
+  if (file == NULL) {
+    return 0;
+  }
+
+  for (int i = 0; i < histogram_count; i++) {
+    write_histogram(file, &histograms[i]);
+  }
+  fprintf(file,
+          "# HELP clock_frames_total Frames presented.\n"
+          "# TYPE clock_frames_total counter\n"
+          "clock_frames_total %u\n"
+          "# HELP clock_skipped_frames_total Frame slots missed by the "
+          "scheduler.\n"
+          "# TYPE clock_skipped_frames_total counter\n"
+          "clock_skipped_frames_total %u\n"
+          "# HELP clock_face_cache_lookups_total Face cache lookups by "
+          "result.\n"
+          "# TYPE clock_face_cache_lookups_total counter\n"
+          "clock_face_cache_lookups_total{result=\"hit\"} %d\n"
+          "clock_face_cache_lookups_total{result=\"miss\"} %d\n",
+          SDL_GetAtomicU32(&stats->written),
+          SDL_GetAtomicU32(&stats->skipped_frames),
+          SDL_GetAtomicInt(&face_cache_hits),
+          SDL_GetAtomicInt(&face_cache_misses));
+
+  if (fclose(file) != 0 || rename(temp_path, path) != 0) {
+    unlink(temp_path);
+    return 0;
+  }
+  return 1;
+}
+
+int metrics_exporter_thread(void *data) {
+  static const double frame_bounds[] = {0.0005, 0.001, 0.002, 0.004,
+                                        0.008,  0.016, 0.033, 0.05,
+                                        0.1,    0.25,  0.5,   1};
+  static const double late_bounds[] = {0.0001, 0.00025, 0.0005, 0.001,
+                                       0.002,  0.005,   0.01,   0.025,
+                                       0.05,   0.1,     0.25,   1};
+  static FrameSample samples[FRAME_HISTORY];
+  MetricsExporter *exporter = data;
+  Histogram histograms[] = {
+      {"clock_frame_time_seconds", "Time from frame start to present.",
+       frame_bounds, sizeof(frame_bounds) / sizeof(frame_bounds[0]), {0}, 0,
+       0},
+      {"clock_wake_lateness_seconds",
+       "How late the main loop woke for each frame.", late_bounds,
+       sizeof(late_bounds) / sizeof(late_bounds[0]), {0}, 0, 0},
+  };
+  Uint32 exported = 0;
+  int stopping = 0;
+
+  while (!stopping) {
+    for (int waited = 0; waited < exporter->interval_ms;
+         waited += RELOAD_POLL_MS) {
+      if (SDL_GetAtomicInt(&exporter->stop)) {
+        stopping = 1;
+        break;
+      }
+      SDL_Delay(RELOAD_POLL_MS);
+    }
+
+    // Samples that were overwritten since the last pass are lost rather
+    // than counted twice
+    Uint32 end;
+    int count = copy_frame_samples(exporter->stats, samples, FRAME_HISTORY,
+                                   &end);
+    Uint32 fresh = end - exported;
+    int first = fresh < (Uint32)count ? count - (int)fresh : 0;
+    for (int i = first; i < count; i++) {
+      histogram_observe(&histograms[0], samples[i].frame_ns / 1e9);
+      histogram_observe(&histograms[1], samples[i].wake_late_ns / 1e9);
+    }
+    exported = end;
+
+    int histogram_count = sizeof(histograms) / sizeof(histograms[0]);
+    if (!write_metrics_file(exporter->path, histograms, histogram_count,
+                            exporter->stats)) {
+      log_message(LOG_ERROR, "Unable to write %s", exporter->path);
+    }
+  }
+  return 0;
+}
+
+int start_metrics_exporter(MetricsExporter *exporter, const char *path,
+                           int interval_ms, FrameStats *stats) {
+  exporter->path = path;
+  exporter->interval_ms = interval_ms;
+  exporter->stats = stats;
+  exporter->thread =
+      SDL_CreateThread(metrics_exporter_thread, "metrics", exporter);
+  if (exporter->thread == NULL) {
+    fprintf(stderr, "Unable to start metrics exporter: %s\n", SDL_GetError());
+    return 0;
+  }
+  return 1;
+}
+
+// The exporter writes the file one last time on its way out.
+void stop_metrics_exporter(MetricsExporter *exporter) {
+  if (exporter->thread == NULL) {
+    return;
+  }
+  SDL_SetAtomicInt(&exporter->stop, 1);
+  SDL_WaitThread(exporter->thread, NULL);
+  exporter->thread = NULL;
+}
+
+#ifdef __GLIBC__
+static int watchdog_trace_fd = -1;
+static volatile sig_atomic_t watchdog_trace_done;
+
+// Runs on the stalled thread. backtrace_symbols_fd doesn't allocate, and
+// backtrace was called once up front so its lazy loading is already done.
+// A sleep or poll the thread was blocked in may return early with EINTR.
+void watchdog_signal(int signal) {
+  (void)signal;
+  void *frames[WATCHDOG_MAX_FRAMES];
+  int count = backtrace(frames, WATCHDOG_MAX_FRAMES);
+  backtrace_symbols_fd(frames, count, watchdog_trace_fd);
+  watchdog_trace_done = 1;
+}
+#endif
+
+// Records go straight to the file descriptor in single writes and are
+// synced, so they survive the process being killed mid-stall.
+void watchdog_log(Watchdog *watchdog, const char *text) {
+  ssize_t written = write(watchdog->log_fd, text, strlen(text));
+  (void)written;
+  fsync(watchdog->log_fd);
+}
+
+void watchdog_backtrace(Watchdog *watchdog) {
+#ifdef __GLIBC__
+  watchdog_trace_done = 0;
+  if (pthread_kill(watchdog->target, WATCHDOG_SIGNAL) != 0) {
+    return;
+  }
+  for (int waited = 0; !watchdog_trace_done && waited < 100; waited++) {
+    SDL_Delay(1);
+  }
+  fsync(watchdog->log_fd);
+#else
+  (void)watchdog;
+#endif
+}
+
+int watchdog_thread(void *data) {
+  Watchdog *watchdog = data;
+  int poll_ms = watchdog->threshold_ms / 4;
+  if (poll_ms < 10) {
+    poll_ms = 10;
+  }
+  Uint32 last_beat = SDL_GetAtomicU32(&watchdog->heartbeat);
+  Uint64 last_change_ns = monotonic_ns();
+  int stalled = 0;
+  char text[256];
+
+  while (!SDL_GetAtomicInt(&watchdog->stop)) {
+    SDL_Delay(poll_ms);
+    Uint32 beat = SDL_GetAtomicU32(&watchdog->heartbeat);
+    FramePhase phase = SDL_GetAtomicInt(&watchdog->phase);
+    Uint64 now = monotonic_ns();
+
+    if (beat != last_beat) {
+      if (stalled) {
+        snprintf(text, sizeof(text), "stall cleared after %.1f ms\n",
+                 (now - last_change_ns) / 1e6);
+        watchdog_log(watchdog, text);
+        stalled = 0;
+      }
+      last_beat = beat;
+      last_change_ns = now;
+      continue;
+    }
+
+    if (!stalled && phase != PHASE_IDLE &&
+        now - last_change_ns >= (Uint64)watchdog->threshold_ms * 1000000) {
+      stalled = 1;
+      time_t wall = time(NULL);
+      struct tm wall_tm;
+      char stamp[32];
+      strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S",
+               localtime_r(&wall, &wall_tm));
+      Uint64 frame = __atomic_load_n(&watchdog->frame, __ATOMIC_RELAXED);
+      snprintf(text, sizeof(text),
+               "%s stall in %s: frame %llu, %.1f ms and counting\n", stamp,
+               FRAME_PHASE_NAMES[phase], (unsigned long long)frame,
+               (now - last_change_ns) / 1e6);
+      watchdog_log(watchdog, text);
+      watchdog_backtrace(watchdog);
+    }
+  }
+  return 0;
+}
+
+int start_watchdog(Watchdog *watchdog, int threshold_ms, const char *path) {
+  watchdog->threshold_ms = threshold_ms;
+  watchdog->log_fd = STDERR_FILENO;
+  if (path != NULL) {
+    watchdog->log_fd =
+        open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (watchdog->log_fd < 0) {
+      fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+      return 0;
+    }
+  }
+
+#ifdef __GLIBC__
+  void *frames[1];
+  backtrace(frames, 1);
+  watchdog_trace_fd = watchdog->log_fd;
+  watchdog->target = pthread_self();
+  struct sigaction action = {0};
+  action.sa_handler = watchdog_signal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(WATCHDOG_SIGNAL, &action, NULL);
+#endif
+
+  watchdog->thread = SDL_CreateThread(watchdog_thread, "watchdog", watchdog);
+  if (watchdog->thread == NULL) {
+    fprintf(stderr, "Unable to start watchdog: %s\n", SDL_GetError());
+    if (watchdog->log_fd != STDERR_FILENO) {
+      close(watchdog->log_fd);
+    }
+    return 0;
+  }
+  return 1;
+}
+
+void stop_watchdog(Watchdog *watchdog) {
+  if (watchdog->thread == NULL) {
+    return;
+  }
+  SDL_SetAtomicInt(&watchdog->stop, 1);
+  SDL_WaitThread(watchdog->thread, NULL);
+  watchdog->thread = NULL;
+  if (watchdog->log_fd != STDERR_FILENO) {
+    close(watchdog->log_fd);
+  }
+}
+
+void handle_event(Clock *clock, const SDL_Event *event) {
+  // With several windows, closing any of them quits
+  if (event->type == SDL_EVENT_QUIT ||
+      event->type == SDL_EVENT_WINDOW_CLOSE_REQUESTED) {
+    clock->running = 0;
+  }
+  if (event->type == SDL_EVENT_KEY_DOWN && event->key.key == SDLK_ESCAPE) {
+    clock->running = 0;
+  }
+  // A replay's only output is what --checksum and --bench report
+  if (event->type == SDL_EVENT_KEY_DOWN && event->key.key == SDLK_F12 &&
+      !event->key.repeat && clock->replay == NULL) {
+    clock->screenshot_requested_ns = monotonic_ns();
+  }
+}
+
+// Records an event, if recording, and acts on it.
+void dispatch_event(Clock *clock, const SDL_Event *event) {
+  if (clock->event_log != NULL) {
+    EventLogRecord record = {EVENT_LOG_EVENT, 0, monotonic_ns(), 0, *event};
+    fwrite(&record, sizeof(record), 1, clock->event_log);
+  }
+  handle_event(clock, event);
+}
+
+// Feeds back the events recorded before the next frame and loads the time
+// it showed. The loop stops at the end of the log.
+void replay_events(Clock *clock) {
+  EventLogRecord record;
+  while (fread(&record, sizeof(record), 1, clock->replay) == 1) {
+    if (record.kind == EVENT_LOG_FRAME) {
+      clock->replay_time_ns = record.time_ns;
+      if (clock->replay_first_ns == 0) {
+        clock->replay_first_ns = record.monotonic_ns;
+      }
+      clock->replay_last_ns = record.monotonic_ns;
+      return;
+    }
+    clock->replay_events++;
+    handle_event(clock, &record.event);
+  }
+  clock->running = 0;
+}
+
+void handle_events(Clock *clock) {
+  if (clock->replay != NULL) {
+    replay_events(clock);
+    return;
+  }
+
+  SDL_Event event;
+  while (SDL_PollEvent(&event)) {
+    dispatch_event(clock, &event);
+  }
+  const Options *options = &clock->options;
+  for (int i = 0; i < options->injected_count; i++) {
+    if ((Uint64)options->injected[i].frame == clock->frame_count) {
+      memset(&event, 0, sizeof(event));
+      event.type = SDL_EVENT_KEY_DOWN;
+      event.key.key = options->injected[i].key;
+      event.key.down = true;
+      dispatch_event(clock, &event);
+    }
+  }
+  if (screenshot_signalled) {
+    screenshot_signalled = 0;
+    clock->screenshot_requested_ns = monotonic_ns();
+  }
+  if (terminal_quit) {
+    clock->running = 0;
+  }
+}
+
+int parse_bool(const char *value, int *result) {
+  if (strcmp(value, "1") == 0 || strcmp(value, "yes") == 0 ||
+      strcmp(value, "true") == 0 || strcmp(value, "on") == 0) {
+    *result = 1;
+  } else if (strcmp(value, "0") == 0 || strcmp(value, "no") == 0 ||
+             strcmp(value, "false") == 0 || strcmp(value, "off") == 0) {
+    *result = 0;
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+// Options that may be given on the command line without a value.
+int is_flag_option(const char *key) {
+  static const char *const flags[] = {"startup-trace", "headless", "bench",
+                                      "terminal", "predict-present"};
+
+  for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+    if (strcmp(key, flags[i]) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int parse_int(const char *value, int min, int max, int *result) {
+  char *end;
+  long number = strtol(value, &end, 10);
+  if (end == value || *end != '\0' || number < min || number > max) {
+    return 0;
+  }
+  *result = (int)number;
+  return 1;
+}
+
+int parse_float(const char *value, float min, float max, float *result) {
+  char *end;
+  float number = strtof(value, &end);
+  if (end == value || *end != '\0' || number < min || number > max) {
+    return 0;
+  }
+  *result = number;
+  return 1;
+}
+
+// Parses YYYY-MM-DDTHH:MM:SS[.mmm] as local time.
+int parse_time(const char *value, Sint64 *epoch_ms) {
+  struct tm tm = {0};
+  int milliseconds = 0;
+  int consumed = 0;
+
+  if (sscanf(value, "%d-%d-%dT%d:%d:%d%n", &tm.tm_year, &tm.tm_mon,
+             &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec,
+             &consumed) != 6) {
+    return 0;
+  }
+  if (value[consumed] == '.') {
+    if (!parse_int(value + consumed + 1, 0, 999, &milliseconds)) {
+      return 0;
+    }
+  } else if (value[consumed] != '\0') {
+    return 0;
+  }
+
+  tm.tm_year -= 1900;
+  tm.tm_mon -= 1;
+  tm.tm_isdst = -1;
+  time_t seconds = mktime(&tm);
+  if (seconds == (time_t)-1) {
+    return 0;
+  }
+  *epoch_ms = (Sint64)seconds * 1000 + milliseconds;
+  return 1;
+}
+
+// "all", or comma-separated indices into SDL's display list, as a mask.
+int parse_displays(const char *value, Uint32 *mask) {
+  if (strcmp(value, "all") == 0) {
+    *mask = 0xffffffffu >> (32 - MAX_DISPLAYS);
+    return 1;
+  }
+  *mask = 0;
+  for (const char *p = value;;) {
+    char *end;
+    long index = strtol(p, &end, 10);
+    if (end == p || index < 0 || index >= MAX_DISPLAYS) {
+      return 0;
+    }
+    *mask |= 1u << index;
+    if (*end == '\0') {
+      return 1;
+    }
+    if (*end != ',') {
+      return 0;
+    }
+    p = end + 1;
+  }
+}
+
+// Parses KEY@FRAME[,KEY@FRAME...], where KEY is f12 or escape.
+int parse_injected_events(const char *value, Options *options) {
+  options->injected_count = 0;
+  for (const char *p = value;;) {
+    InjectedEvent *event = &options->injected[options->injected_count];
+    if (options->injected_count == MAX_INJECTED_EVENTS) {
+      return 0;
+    }
+    if (strncmp(p, "f12@", 4) == 0) {
+      event->key = SDLK_F12;
+      p += 4;
+    } else if (strncmp(p, "escape@", 7) == 0) {
+      event->key = SDLK_ESCAPE;
+      p += 7;
+    } else {
+      return 0;
+    }
+    char *end;
+    long frame = strtol(p, &end, 10);
+    if (end == p || frame < 0 || frame > 2000000000) {
+      return 0;
+    }
+    event->frame = (int)frame;
+    options->injected_count++;
+    if (*end == '\0') {
+      return 1;
+    }
+    if (*end != ',') {
+      return 0;
+    }
+    p = end + 1;
+  }
+}
+
+int apply_option(Options *options, const char *key, const char *value) {
+  if (strcmp(key, "config") == 0) {
+    options->config_path = value;
+  } else if (strcmp(key, "face") == 0) {
+    options->face_path = value;
+  } else if (strcmp(key, "cache-dir") == 0) {
+    options->cache_dir = value;
+  } else if (strcmp(key, "render-driver") == 0) {
+    options->render_driver = value;
+  } else if (strcmp(key, "startup-trace") == 0) {
+    return parse_bool(value, &options->startup_trace);
+  } else if (strcmp(key, "headless") == 0) {
+    return parse_bool(value, &options->headless);
+  } else if (strcmp(key, "scale") == 0) {
+    return parse_float(value, 0.1f, 16.0f, &options->scale);
+  } else if (strcmp(key, "time") == 0) {
+    options->virtual_time = 1;
+    return parse_time(value, &options->start_time_ms);
+  } else if (strcmp(key, "time-step") == 0) {
+    return parse_int(value, 0, 86400000, &options->time_step_ms);
+  } else if (strcmp(key, "frames") == 0) {
+    return parse_int(value, 0, 2000000000, &options->frames);
+  } else if (strcmp(key, "screenshot") == 0) {
+    options->screenshot_path = value;
+  } else if (strcmp(key, "compare") == 0) {
+    options->compare_path = value;
+  } else if (strcmp(key, "tolerance") == 0) {
+    return parse_int(value, 0, 255, &options->tolerance);
+  } else if (strcmp(key, "bench") == 0) {
+    return parse_bool(value, &options->bench);
+  } else if (strcmp(key, "log-bench") == 0) {
+    return parse_int(value, 1, 1000000, &options->log_bench_ns);
+  } else if (strcmp(key, "terminal") == 0) {
+    return parse_bool(value, &options->terminal);
+  } else if (strcmp(key, "predict-present") == 0) {
+    return parse_bool(value, &options->predict_present);
+  } else if (strcmp(key, "pixel-format") == 0) {
+    if (strcmp(value, "xrgb8888") == 0) {
+      options->pixel_format = SDL_PIXELFORMAT_XRGB8888;
+    } else if (strcmp(value, "rgb565") == 0) {
+      options->pixel_format = SDL_PIXELFORMAT_RGB565;
+    } else if (strcmp(value, "index8") == 0) {
+      options->pixel_format = SDL_PIXELFORMAT_INDEX8;
+    } else {
+      return 0;
+    }
+    options->pixel_format_name = value;
+  } else if (strcmp(key, "sync") == 0) {
+    if (strcmp(value, "leader") == 0) {
+      options->sync_role = SYNC_LEADER;
+    } else if (strcmp(value, "follower") == 0) {
+      options->sync_role = SYNC_FOLLOWER;
+    } else if (strcmp(value, "off") == 0) {
+      options->sync_role = SYNC_OFF;
+    } else {
+      return 0;
+    }
+  } else if (strcmp(key, "sync-group") == 0) {
+    options->sync_group = value;
+  } else if (strcmp(key, "sync-port") == 0) {
+    return parse_int(value, 1, 65535, &options->sync_port);
+  } else if (strcmp(key, "sync-threshold-us") == 0) {
+    return parse_int(value, 0, 10000000, &options->sync_threshold_us);
+  } else if (strcmp(key, "motion") == 0) {
+    if (strcmp(value, "sweep") == 0) {
+      options->motion = MOTION_SWEEP;
+    } else if (strcmp(value, "swiss") == 0) {
+      options->motion = MOTION_SWISS;
+    } else if (strcmp(value, "tick") == 0) {
+      options->motion = MOTION_TICK;
+    } else {
+      return 0;
+    }
+  } else if (strcmp(key, "displays") == 0) {
+    return parse_displays(value, &options->display_mask);
+  } else if (strcmp(key, "screenshot-dir") == 0) {
+    options->screenshot_dir = value;
+  } else if (strcmp(key, "share") == 0) {
+    if (value[0] != '/' || strchr(value + 1, '/') != NULL) {
+      return 0;
+    }
+    options->share_name = value;
+  } else if (strcmp(key, "bench-threshold-us") == 0) {
+    return parse_int(value, 0, 10000000, &options->bench_threshold_us);
+  } else if (strcmp(key, "checksum") == 0) {
+    options->checksum_path = value;
+  } else if (strcmp(key, "stats-socket") == 0) {
+    options->stats_socket_path = value;
+  } else if (strcmp(key, "metrics-file") == 0) {
+    options->metrics_path = value;
+  } else if (strcmp(key, "metrics-interval") == 0) {
+    int seconds;
+    if (!parse_int(value, 1, 86400, &seconds)) {
+      return 0;
+    }
+    options->metrics_interval_ms = seconds * 1000;
+  } else if (strcmp(key, "watchdog") == 0) {
+    return parse_int(value, 0, 600000, &options->watchdog_ms);
+  } else if (strcmp(key, "watchdog-log") == 0) {
+    options->watchdog_log_path = value;
+  } else if (strcmp(key, "realtime") == 0) {
+    if (strcmp(value, "off") == 0) {
+      options->realtime = NULL;
+    } else if (strcmp(value, "fifo") == 0 || strcmp(value, "rr") == 0) {
+      options->realtime = value;
+    } else {
+      return 0;
+    }
+  } else if (strcmp(key, "cpu") == 0) {
+    return parse_int(value, 0, 1023, &options->cpu);
+  } else if (strcmp(key, "pose-log") == 0) {
+    options->pose_log_path = value;
+  } else if (strcmp(key, "log-level") == 0) {
+    static const char *const levels[] = {"error", "warn", "info", "debug"};
+    for (int i = 0; i < (int)(sizeof(levels) / sizeof(levels[0])); i++) {
+      if (strcmp(value, levels[i]) == 0) {
+        options->log_level = i;
+        return 1;
+      }
+    }
+    return 0;
+  } else if (strcmp(key, "log-rate") == 0) {
+    return parse_int(value, 0, 1000000, &options->log_rate);
+  } else if (strcmp(key, "record") == 0) {
+    options->record_path = value;
+  } else if (strcmp(key, "replay") == 0) {
+    options->replay_path = value;
+  } else if (strcmp(key, "inject-events") == 0) {
+    return parse_injected_events(value, options);
+  } else if (strcmp(key, "soak-days") == 0) {
+    return parse_int(value, 1, MAX_SOAK_DAYS, &options->soak_days);
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+void print_usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  --config PATH     read options from PATH (key = value lines)\n"
+          "  --face PATH       face description to draw\n"
+          "  --cache-dir DIR   where compiled faces are cached\n"
+          "  --render-driver NAME\n"
+          "                    SDL render driver, 'auto' (probe once and\n"
+          "                    cache the fastest) or 'default'\n"
+          "  --startup-trace   report time spent in each startup stage\n"
+          "  --headless        render off screen with the software renderer\n"
+          "  --scale N         headless scale factor (default 1)\n"
+          "  --time YYYY-MM-DDTHH:MM:SS[.mmm]\n"
+          "                    show virtual time starting here\n"
+          "  --time-step MS    virtual time advance per frame (default 100)\n"
+          "  --frames N        stop after N frames (headless default 1)\n"
+          "  --screenshot PATH save the last frame as a BMP\n"
+          "  --compare PATH    fail unless the last frame matches this BMP\n"
+          "  --tolerance N     allowed per-channel difference for --compare\n"
+          "  --bench           report frame time statistics on exit\n"
+          "  --log-bench NS    time a queued log call and fail if the\n"
+          "                    median is over NS nanoseconds\n"
+          "  --terminal        draw the clock in braille on this terminal\n"
+          "  --share /NAME     publish frames in a shared-memory ring\n"
+          "  --pixel-format xrgb8888|rgb565|index8\n"
+          "                    rasterize in software in this format; in a\n"
+          "                    window, stream it through a texture\n"
+          "  --predict-present draw each frame for the refresh it is\n"
+          "                    predicted to reach (turns on vsync)\n"
+          "  --motion sweep|swiss|tick\n"
+          "                    second hand: smooth sweep, a station\n"
+          "                    clock's 58.5 s sweep and stop at 12, or a\n"
+          "                    spring-damped tick each second\n"
+          "  --displays all|N[,M...]\n"
+          "                    open a window on each of these displays\n"
+          "                    (numbered from 0), each drawn on its own\n"
+          "                    thread\n"
+          "  --sync leader|follower|off\n"
+          "                    keep ticks in phase with other instances\n"
+          "  --sync-group ADDR multicast group (default " SYNC_DEFAULT_GROUP
+          ")\n"
+          "  --sync-port PORT  multicast port (default 47777)\n"
+          "  --sync-threshold-us N\n"
+          "                    as a follower, fail if the p99 phase error\n"
+          "                    exceeds N us or the leader wasn't heard\n"
+          "  --screenshot-dir DIR\n"
+          "                    where F12 and SIGUSR1 save PNG screenshots\n"
+          "                    (default .)\n"
+          "  --bench-threshold-us N\n"
+          "                    fail if the median frame time exceeds N us\n"
+          "  --checksum PATH   log a hash of every frame ('-' for stdout)\n"
+          "  --stats-socket PATH\n"
+          "                    serve JSON frame statistics on a Unix socket\n"
+          "  --metrics-file PATH\n"
+          "                    keep a Prometheus textfile with frame metrics\n"
+          "  --metrics-interval SECONDS\n"
+          "                    how often to rewrite it (default 15)\n"
+          "  --watchdog MS     log frames stalled for longer than MS\n"
+          "  --watchdog-log PATH\n"
+          "                    where stall reports go (default stderr)\n"
+          "  --realtime fifo|rr|off\n"
+          "                    real-time priority and locked memory after\n"
+          "                    warm-up (falls back to niceness)\n"
+          "  --cpu N           pin the render thread to CPU N\n"
+          "  --pose-log PATH   record every frame's time and hand angles\n"
+          "                    (read with pose_reader)\n"
+          "  --log-level error|warn|info|debug\n"
+          "                    least severe messages to log (default info)\n"
+          "  --log-rate N      messages per second from any one place\n"
+          "                    (default 10, 0 for no limit)\n"
+          "  --record PATH     record input events and time samples\n"
+          "  --replay PATH     replay a recording headlessly, as fast as\n"
+          "                    possible\n"
+          "  --inject-events KEY@FRAME[,...]\n"
+          "                    press f12 or escape before the given frames,\n"
+          "                    as if typed (for recording headless runs)\n"
+          "  --soak-days N     run N simulated days headlessly and fail on\n"
+          "                    steadily growing resource use\n",
+          program);
+}
+
+// Applies "key = value" lines using the same keys as the long options.
+// Values point into the returned buffer, which the caller frees.
+char *load_config(const char *path, Options *options) {
+  char *text = read_file(path, NULL);
+  if (text == NULL) {
+    fprintf(stderr, "Unable to read config %s\n", path);
+    return NULL;
+  }
+
+  int line_number = 0;
+  char *save;
+  for (char *line = strtok_r(text, "\n", &save); line != NULL;
+       line = strtok_r(NULL, "\n", &save)) {
+    line_number++;
+    line += strspn(line, " \t");
+    if (line[0] == '\0' || line[0] == '#' || line[0] == '\r') {
+      continue;
+    }
+
+    char *value = strchr(line, '=');
+    if (value == NULL) {
+      fprintf(stderr, "%s:%d: expected key = value\n", path, line_number);
+      free(text);
+      return NULL;
+    }
+
+    char *key_end = value;
+    while (key_end > line && (key_end[-1] == ' ' || key_end[-1] == '\t')) {
+      key_end--;
+    }
+    *key_end = '\0';
+    value++;
+    value += strspn(value, " \t");
+    char *value_end = value + strlen(value);
+    while (value_end > value && strchr(" \t\r", value_end[-1]) != NULL) {
+      value_end--;
+    }
+    *value_end = '\0';
+
+    if (strcmp(line, "config") == 0 || !apply_option(options, line, value)) {
+      fprintf(stderr, "%s:%d: unknown option '%s'\n", path, line_number,
+              line);
+      free(text);
+      return NULL;
+    }
+  }
+
+  return text;
+}
+
+// Fills options from the config file named by --config, if any, then from
+// the command line, which takes precedence. *config_text receives the
+// config buffer the options may point into.
+int load_options(int argc, char **argv, Options *options, char **config_text) {
+  memset(options, 0, sizeof(*options));
+  options->time_step_ms = -1;
+  options->metrics_interval_ms = 15000;
+  options->cpu = -1;
+  options->screenshot_dir = ".";
+  options->sync_group = SYNC_DEFAULT_GROUP;
+  options->sync_port = SYNC_DEFAULT_PORT;
+  options->log_level = LOG_INFO;
+  options->log_rate = LOG_DEFAULT_RATE;
+  *config_text = NULL;
+
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--config") == 0) {
+      options->config_path = argv[i + 1];
+    }
+  }
+  if (options->config_path != NULL) {
+    *config_text = load_config(options->config_path, options);
+    if (*config_text == NULL) {
+      return 0;
+    }
+  }
+
+  for (int i = 1; i < argc; i++) {
+    const char *key = NULL;
+    const char *value = NULL;
+    if (strncmp(argv[i], "--", 2) == 0) {
+      key = argv[i] + 2;
+      int flag = is_flag_option(key);
+      if (i + 1 < argc && !(flag && strncmp(argv[i + 1], "--", 2) == 0)) {
+        value = argv[++i];
+      } else if (flag) {
+        value = "1";
+      }
+    }
+
+    if (value == NULL || !apply_option(options, key, value)) {
+      print_usage(argv[0]);
+      free(*config_text);
+      *config_text = NULL;
+      return 0;
+    }
+  }
+
+  // Sync packets assume every instance ticks on the same 100 ms grid
+  if (options->sync_role != SYNC_OFF && options->motion != MOTION_SWEEP) {
+    fprintf(stderr, "--sync needs --motion sweep\n");
+    free(*config_text);
+    *config_text = NULL;
+    return 0;
+  }
+  return 1;
+}
+
+// Builds the face at scale_factor and parks it in pending, dropping a
+// previous list that was never picked up.
+int park_display_list(void **pending, const Options *options,
+                      float scale_factor) {
+  DisplayList *list = malloc(sizeof(DisplayList));
+  if (list == NULL || !load_display_list(options, scale_factor, list)) {
+    free(list);
+    return 0;
+  }
+  DisplayList *stale = SDL_SetAtomicPointer(pending, list);
+  if (stale != NULL) {
+    free_display_list(stale);
+    free(stale);
+  }
+  return 1;
+}
+
+// Re-reads the config and face files into options/config_text and parks
+// the rebuilt display list for the render loop. A previous pending list
+// that the render loop never picked up is dropped.
+// Everything but the face and the log settings is read once at startup.
+// Kinds: 's' string, 'i' int, 'f' float, 'u' Uint32, 'l' Sint64.
+static const struct {
+  const char *key;
+  size_t offset;
+  char kind;
+} RESTART_OPTIONS[] = {
+    {"cache-dir", offsetof(Options, cache_dir), 's'},
+    {"render-driver", offsetof(Options, render_driver), 's'},
+    {"startup-trace", offsetof(Options, startup_trace), 'i'},
+    {"headless", offsetof(Options, headless), 'i'},
+    {"scale", offsetof(Options, scale), 'f'},
+    {"time", offsetof(Options, start_time_ms), 'l'},
+    {"time-step", offsetof(Options, time_step_ms), 'i'},
+    {"frames", offsetof(Options, frames), 'i'},
+    {"screenshot", offsetof(Options, screenshot_path), 's'},
+    {"compare", offsetof(Options, compare_path), 's'},
+    {"tolerance", offsetof(Options, tolerance), 'i'},
+    {"bench", offsetof(Options, bench), 'i'},
+    {"bench-threshold-us", offsetof(Options, bench_threshold_us), 'i'},
+    {"log-bench", offsetof(Options, log_bench_ns), 'i'},
+    {"checksum", offsetof(Options, checksum_path), 's'},
+    {"soak-days", offsetof(Options, soak_days), 'i'},
+    {"pose-log", offsetof(Options, pose_log_path), 's'},
+    {"record", offsetof(Options, record_path), 's'},
+    {"replay", offsetof(Options, replay_path), 's'},
+    {"stats-socket", offsetof(Options, stats_socket_path), 's'},
+    {"metrics-file", offsetof(Options, metrics_path), 's'},
+    {"metrics-interval", offsetof(Options, metrics_interval_ms), 'i'},
+    {"watchdog", offsetof(Options, watchdog_ms), 'i'},
+    {"watchdog-log", offsetof(Options, watchdog_log_path), 's'},
+    {"realtime", offsetof(Options, realtime), 's'},
+    {"cpu", offsetof(Options, cpu), 'i'},
+    {"terminal", offsetof(Options, terminal), 'i'},
+    {"share", offsetof(Options, share_name), 's'},
+    {"screenshot-dir", offsetof(Options, screenshot_dir), 's'},
+    {"pixel-format", offsetof(Options, pixel_format), 'u'},
+    {"sync", offsetof(Options, sync_role), 'i'},
+    {"sync-group", offsetof(Options, sync_group), 's'},
+    {"sync-port", offsetof(Options, sync_port), 'i'},
+    {"sync-threshold-us", offsetof(Options, sync_threshold_us), 'i'},
+    {"motion", offsetof(Options, motion), 'i'},
+    {"predict-present", offsetof(Options, predict_present), 'i'},
+    {"displays", offsetof(Options, display_mask), 'u'},
+};
+
+// Lists, comma separated, the options that differ between old and next
+// but only take effect on a restart. Returns the number listed.
+int changed_restart_options(const Options *old, const Options *next,
+                            char *keys, size_t size) {
+  int changed = 0;
+  size_t length = 0;
+  keys[0] = '\0';
+  for (size_t i = 0; i < sizeof(RESTART_OPTIONS) / sizeof(RESTART_OPTIONS[0]);
+       i++) {
+    const char *a = (const char *)old + RESTART_OPTIONS[i].offset;
+    const char *b = (const char *)next + RESTART_OPTIONS[i].offset;
+    int differs;
+    switch (RESTART_OPTIONS[i].kind) {
+    case 's': {
+      const char *x = *(const char *const *)a;
+      const char *y = *(const char *const *)b;
+      differs = (x == NULL) != (y == NULL) ||
+                (x != NULL && strcmp(x, y) != 0);
+      break;
+    }
+    case 'f':
+      differs = *(const float *)a != *(const float *)b;
+      break;
+    case 'u':
+      differs = *(const Uint32 *)a != *(const Uint32 *)b;
+      break;
+    case 'l':
+      differs = *(const Sint64 *)a != *(const Sint64 *)b;
+      break;
+    default:
+      differs = *(const int *)a != *(const int *)b;
+    }
+    if (differs && length < size) {
+      length += snprintf(keys + length, size - length, "%s%s",
+                         changed ? ", " : "", RESTART_OPTIONS[i].key);
+      changed++;
+    }
+  }
+  return changed;
+}
+
+// Restart-only changes are reported against the options the process
+// started with, so each reload repeats them until the restart.
+void reload_face(FaceReloader *reloader, const Options *started,
+                 Options *options, char **config_text) {
+  Options next;
+  char *next_text;
+  if (!load_options(reloader->argc, reloader->argv, &next, &next_text)) {
+    log_message(LOG_WARN, "Config reload failed, keeping the current face");
+    return;
+  }
+  char keys[512];
+  if (changed_restart_options(started, &next, keys, sizeof(keys)) > 0) {
+    log_message(LOG_WARN, "Config changes to %s take effect on restart",
+                keys);
+  }
+  free(*config_text);
+  *options = next;
+  *config_text = next_text;
+  configure_logger(options->log_level, options->log_rate);
+
+  if (!park_display_list(&reloader->pending, options,
+                         reloader->scale_factor)) {
+    log_message(LOG_WARN, "Face reload failed, keeping the current face");
+    return;
+  }
+  DisplaySet *set = reloader->displays;
+  for (int i = 0; set != NULL && i < set->count; i++) {
+    DisplayContext *display = &set->displays[i];
+    if (!park_display_list(&display->pending, options,
+                           display->scale_factor)) {
+      log_message(LOG_WARN, "Face reload failed on display %u",
+                  (unsigned)display->id);
+    }
+  }
+}
+
+#ifdef __linux__
+// Watches the directories rather than the files, since editors usually
+// save by writing a new file and renaming it over the old one.
+void watch_options(int fd, const Options *options, int *watches) {
+  const char *paths[2] = {options->config_path, options->face_path};
+
+  for (int i = 0; i < 2; i++) {
+    if (watches[i] >= 0) {
+      inotify_rm_watch(fd, watches[i]);
+      watches[i] = -1;
+    }
+    if (paths[i] == NULL) {
+      continue;
+    }
+
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s", paths[i]);
+    char *slash = strrchr(dir, '/');
+    if (slash == NULL) {
+      snprintf(dir, sizeof(dir), ".");
+    } else if (slash == dir) {
+      slash[1] = '\0';
+    } else {
+      *slash = '\0';
+    }
+    watches[i] = inotify_add_watch(
+        fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ATTRIB);
+  }
+}
+
+int event_matches(const struct inotify_event *event, const Options *options) {
+  const char *paths[2] = {options->config_path, options->face_path};
+
+  for (int i = 0; i < 2; i++) {
+    if (paths[i] == NULL || event->len == 0) {
+      continue;
+    }
+    const char *slash = strrchr(paths[i], '/');
+    const char *name = slash ? slash + 1 : paths[i];
+    if (strcmp(event->name, name) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int face_reloader_thread(void *data) {
+  FaceReloader *reloader = data;
+  Options started, options;
+  char *started_text, *config_text;
+  if (!load_options(reloader->argc, reloader->argv, &started, &started_text)) {
+    return 1;
+  }
+  if (!load_options(reloader->argc, reloader->argv, &options, &config_text)) {
+    free(started_text);
+    return 1;
+  }
+
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) {
+    log_message(LOG_WARN, "inotify unavailable, face reloading disabled");
+    free(config_text);
+    free(started_text);
+    return 1;
+  }
+  int watches[2] = {-1, -1};
+  watch_options(fd, &options, watches);
+
+  char buffer[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  while (!SDL_GetAtomicInt(&reloader->stop)) {
+    struct pollfd pfd = {fd, POLLIN, 0};
+    if (poll(&pfd, 1, RELOAD_POLL_MS) <= 0) {
+      continue;
+    }
+
+    // Let a burst of writes from one save settle, then drain it
+    int changed = 0;
+    SDL_Delay(RELOAD_SETTLE_MS);
+    ssize_t length;
+    while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+      for (char *p = buffer; p < buffer + length;) {
+        const struct inotify_event *event = (const struct inotify_event *)p;
+        changed |= event_matches(event, &options);
+        p += sizeof(struct inotify_event) + event->len;
+      }
+    }
+    if (!changed) {
+      continue;
+    }
+
+    reload_face(reloader, &started, &options, &config_text);
+    watch_options(fd, &options, watches);
+  }
+
+  close(fd);
+  free(config_text);
+  free(started_text);
+  return 0;
+}
+#else
+// Without inotify, poll the files' identity instead.
+int face_reloader_thread(void *data) {
+  FaceReloader *reloader = data;
+  Options started, options;
+  char *started_text, *config_text;
+  if (!load_options(reloader->argc, reloader->argv, &started, &started_text)) {
+    return 1;
+  }
+  if (!load_options(reloader->argc, reloader->argv, &options, &config_text)) {
+    free(started_text);
+    return 1;
+  }
+
+  Uint64 config_hash = 0, face_hash = 0;
+  if (options.config_path != NULL) {
+    face_source_hash(options.config_path, &config_hash);
+  }
+  face_source_hash(options.face_path, &face_hash);
+
+  while (!SDL_GetAtomicInt(&reloader->stop)) {
+    SDL_Delay(RELOAD_POLL_MS);
+
+    Uint64 new_config_hash = 0, new_face_hash = 0;
+    if (options.config_path != NULL) {
+      face_source_hash(options.config_path, &new_config_hash);
+    }
+    face_source_hash(options.face_path, &new_face_hash);
+    if (new_config_hash == config_hash && new_face_hash == face_hash) {
+      continue;
+    }
+
+    reload_face(reloader, &started, &options, &config_text);
+    config_hash = 0;
+    if (options.config_path != NULL) {
+      face_source_hash(options.config_path, &config_hash);
+    }
+    face_source_hash(options.face_path, &face_hash);
+  }
+
+  free(config_text);
+  free(started_text);
+  return 0;
+}
+#endif
+
+void start_face_reloader(Clock *clock, int argc, char **argv) {
+  FaceReloader *reloader = &clock->reloader;
+
+  // Nothing to watch when drawing the built-in face without a config
+  if (clock->options.config_path == NULL && clock->options.face_path == NULL) {
+    return;
+  }
+
+  reloader->argc = argc;
+  reloader->argv = argv;
+  reloader->scale_factor = clock->scale_factor;
+  reloader->thread =
+      SDL_CreateThread(face_reloader_thread, "face reloader", reloader);
+}
+
+void stop_face_reloader(FaceReloader *reloader) {
+  if (reloader->thread == NULL) {
+    return;
+  }
+
+  SDL_SetAtomicInt(&reloader->stop, 1);
+  SDL_WaitThread(reloader->thread, NULL);
+  reloader->thread = NULL;
+
+  DisplayList *pending = SDL_SetAtomicPointer(&reloader->pending, NULL);
+  if (pending != NULL) {
+    free_display_list(pending);
+    free(pending);
+  }
+}
+
+// Called between frames, so a frame is always drawn from a single list.
+void apply_reloaded_face(Clock *clock) {
+  DisplayList *pending = SDL_SetAtomicPointer(&clock->reloader.pending, NULL);
+  if (pending == NULL) {
+    return;
+  }
+
+  free_display_list(&clock->display_list);
+  clock->display_list = *pending;
+  free(pending);
+  if (clock->surface != NULL &&
+      clock->surface->format == SDL_PIXELFORMAT_INDEX8) {
+    set_face_palette(clock, clock->surface);
+  }
+}
+
+// Times log_message's queued path in batches small enough never to fill the
+// ring, waiting for the writer to drain it between batches. The calls match
+// the loop's heaviest: an integer, a double and a string. Returns whether
+// the median batch's cost per call is within budget_ns.
+int run_log_bench(int budget_ns) {
+  enum { BATCHES = 200, BATCH_CALLS = LOG_RING_SIZE / 2 };
+  static Uint64 batches[BATCHES];
+  configure_logger(LOG_INFO, 0);
+  start_logger();
+  if (!SDL_GetAtomicInt(&logger.running)) {
+    return 0;
+  }
+  // The first call adds the ring and learns the call site
+  log_message(LOG_INFO, "log-bench frame %d took %.3f ms on %s", 0, 0.0, "-");
+
+  for (int b = 0; b < BATCHES; b++) {
+    while (__atomic_load_n(&log_ring->head, __ATOMIC_ACQUIRE) !=
+           log_ring->tail) {
+      SDL_Delay(1);
+    }
+    Uint64 start = monotonic_ns();
+    for (int i = 0; i < BATCH_CALLS; i++) {
+      log_message(LOG_INFO, "log-bench frame %d took %.3f ms on %s", i,
+                  i * 0.001, "display 1");
+    }
+    batches[b] = monotonic_ns() - start;
+  }
+  Uint32 dropped = __atomic_load_n(&log_ring->dropped, __ATOMIC_RELAXED);
+  stop_logger();
+
+  qsort(batches, BATCHES, sizeof(Uint64), compare_ns);
+  double median_ns = (double)batches[BATCHES / 2] / BATCH_CALLS;
+  double max_ns = (double)batches[BATCHES - 1] / BATCH_CALLS;
+  fprintf(stderr,
+          "log_message: median %.1f ns, worst batch %.1f ns per call over "
+          "%d calls, %u dropped\n",
+          median_ns, max_ns, BATCHES * BATCH_CALLS, dropped);
+  if (dropped > 0 || median_ns > budget_ns) {
+    fprintf(stderr, "log_message exceeds its %d ns budget\n", budget_ns);
+    return 0;
+  }
+  return 1;
+}
+
+int main(int argc, char **argv) {
+  Clock clock = {0};
+  char *config_text;
+
+  clock.startup_ns[STARTUP_PROCESS] = process_start_ns();
+  mark_startup(&clock, STARTUP_MAIN);
+
+  if (!load_options(argc, argv, &clock.options, &config_text)) {
+    return 1;
+  }
+
+  Options *options = &clock.options;
+  configure_logger(options->log_level, options->log_rate);
+  if (options->log_bench_ns > 0) {
+    free(config_text);
+    return run_log_bench(options->log_bench_ns) ? 0 : 1;
+  }
+  static SoakMonitor soak;
+  if (options->soak_days > 0) {
+    options->headless = 1;
+    if (!options->virtual_time) {
+      options->virtual_time = 1;
+      parse_time(SOAK_DEFAULT_START, &options->start_time_ms);
+    }
+    if (options->time_step_ms < 0) {
+      options->time_step_ms = SOAK_TIME_STEP_MS;
+    }
+    Sint64 frames = options->soak_days * 86400000LL /
+                    (options->time_step_ms > 0 ? options->time_step_ms : 1);
+    options->frames = frames < 2000000000 ? (int)frames + 1 : 2000000000;
+  }
+  if (options->replay_path != NULL) {
+    options->headless = 1;
+    if (!open_replay(&clock, options->replay_path)) {
+      free(config_text);
+      return 1;
+    }
+  }
+  if (options->time_step_ms < 0) {
+    options->time_step_ms = 100;
+  }
+
+  int initialized =
+      options->headless || options->terminal || options->share_name
+          ? init_headless_clock(&clock)
+          : init_clock(&clock);
+  if (!initialized) {
+    free(config_text);
+    return 1;
+  }
+  if (clock.window != NULL && options->pixel_format != 0 &&
+      !init_stream(&clock)) {
+    cleanup_clock(&clock);
+    free(config_text);
+    return 1;
+  }
+  if (options->display_mask != 0 && clock.window == NULL) {
+    log_message(LOG_WARN, "--displays needs a window, ignoring it");
+  } else if (options->display_mask != 0 && !start_displays(&clock)) {
+    cleanup_clock(&clock);
+    free(config_text);
+    return 1;
+  }
+
+  // Only a window has a refresh to predict, and virtual time doesn't follow
+  // it
+  if (options->predict_present && clock.window != NULL &&
+      !options->virtual_time) {
+    SDL_SetRenderVSync(clock.stream != NULL ? clock.window_renderer
+                                            : clock.renderer,
+                       1);
+    start_present_predictor(&clock.predictor, clock.refresh_ns);
+  }
+
+  // A replay runs until the recording ends
+  if (options->headless && options->frames == 0 && clock.replay == NULL) {
+    options->frames = 1;
+  }
+  clock.virtual_time_ms = options->start_time_ms;
+
+  if (options->checksum_path != NULL) {
+    clock.checksum_log = strcmp(options->checksum_path, "-") == 0
+                             ? stdout
+                             : fopen(options->checksum_path, "w");
+    if (clock.checksum_log == NULL) {
+      fprintf(stderr, "Unable to open %s\n", options->checksum_path);
+      cleanup_clock(&clock);
+      free(config_text);
+      return 1;
+    }
+    setvbuf(clock.checksum_log, NULL, _IOFBF, 1 << 20);
+  }
+
+  if (options->pose_log_path != NULL &&
+      !open_pose_log(&clock, options->pose_log_path)) {
+    cleanup_clock(&clock);
+    free(config_text);
+    return 1;
+  }
+  if (options->record_path != NULL &&
+      !open_event_log(&clock, options->record_path)) {
+    cleanup_clock(&clock);
+    free(config_text);
+    return 1;
+  }
+
+  clock.stats.start_ns = monotonic_ns();
+  // With --pixel-format, clock.renderer is the offscreen software one
+  clock.stats.render_driver = SDL_GetRendererName(
+      clock.stream != NULL ? clock.window_renderer : clock.renderer);
+  if (options->stats_socket_path != NULL &&
+      !start_stats_server(&clock.stats_server, options->stats_socket_path,
+                          &clock.stats)) {
+    cleanup_clock(&clock);
+    free(config_text);
+    return 1;
+  }
+  if (options->metrics_path != NULL &&
+      !start_metrics_exporter(&clock.metrics, options->metrics_path,
+                              options->metrics_interval_ms, &clock.stats)) {
+    stop_stats_server(&clock.stats_server);
+    cleanup_clock(&clock);
+    free(config_text);
+    return 1;
+  }
+  if (options->watchdog_ms > 0 &&
+      !start_watchdog(&clock.watchdog, options->watchdog_ms,
+                      options->watchdog_log_path)) {
+    stop_metrics_exporter(&clock.metrics);
+    stop_stats_server(&clock.stats_server);
+    cleanup_clock(&clock);
+    free(config_text);
+    return 1;
+  }
+
+  if (options->share_name != NULL &&
+      !start_frame_share(&clock, options->share_name)) {
+    stop_frame_share(&clock);
+    stop_watchdog(&clock.watchdog);
+    stop_metrics_exporter(&clock.metrics);
+    stop_stats_server(&clock.stats_server);
+    cleanup_clock(&clock);
+    free(config_text);
+    return 1;
+  }
+  if (options->terminal && !start_terminal(&clock.terminal)) {
+    stop_frame_share(&clock);
+    stop_watchdog(&clock.watchdog);
+    stop_metrics_exporter(&clock.metrics);
+    stop_stats_server(&clock.stats_server);
+    cleanup_clock(&clock);
+    free(config_text);
+    return 1;
+  }
+
+  if (options->sync_role != SYNC_OFF &&
+      (!open_phase_sync(&clock.sync, options->sync_role, options->sync_group,
+                        options->sync_port) ||
+       !start_phase_sync(&clock.sync))) {
+    finish_terminal(&clock.terminal);
+    stop_frame_share(&clock);
+    stop_watchdog(&clock.watchdog);
+    stop_metrics_exporter(&clock.metrics);
+    stop_stats_server(&clock.stats_server);
+    cleanup_clock(&clock);
+    free(config_text);
+    return 1;
+  }
+  // Started before apply_realtime so encoding never runs at the render
+  // thread's priority or on its CPU
+  if (!start_screenshot_worker(&clock.screenshots, options->screenshot_dir)) {
+    stop_phase_sync(&clock.sync);
+    finish_terminal(&clock.terminal);
+    stop_frame_share(&clock);
+    stop_watchdog(&clock.watchdog);
+    stop_metrics_exporter(&clock.metrics);
+    stop_stats_server(&clock.stats_server);
+    cleanup_clock(&clock);
+    free(config_text);
+    return 1;
+  }
+  signal(SIGUSR1, screenshot_signal);
+  start_logger();
+
+  int first_frame = 1;
+  while (clock.running) {
+    set_phase(&clock, PHASE_EVENTS);
+    handle_events(&clock);
+    if (!clock.running) {
+      break;
+    }
+    apply_reloaded_face(&clock);
+
+    int last_frame = options->frames > 0 &&
+                     clock.frame_count + 1 >= (Uint64)options->frames;
+    if (last_frame && (options->screenshot_path || options->compare_path)) {
+      clock.capture_requested = 1;
+    }
+    render_clock(&clock);
+    set_phase(&clock, PHASE_PRESENT);
+    present_displays(&clock.displays);
+    set_phase(&clock, PHASE_HOUSEKEEPING);
+    if (options->soak_days > 0) {
+      update_soak(&soak, &clock);
+    }
+
+    // Nothing below is needed to get the face on screen
+    if (first_frame) {
+      first_frame = 0;
+      mark_startup(&clock, STARTUP_FIRST_PRESENT);
+      if (options->startup_trace) {
+        report_startup(&clock);
+      }
+      if (!options->headless) {
+        start_face_reloader(&clock, argc, argv);
+      }
+      apply_realtime(options);
+    }
+
+    clock.virtual_time_ms += options->time_step_ms;
+    set_phase(&clock, PHASE_IDLE);
+    if (last_frame) {
+      clock.running = 0;
+    } else if (!options->headless || options->sync_role != SYNC_OFF) {
+      // Synced headless runs still tick on the real grid, so phase sync
+      // can be tested without a display
+      wait_for_next_frame(&clock);
+    }
+  }
+
+  stop_logger();
+  finish_terminal(&clock.terminal);
+
+  int status = 0;
+  if (options->screenshot_path &&
+      (clock.capture == NULL ||
+       !SDL_SaveBMP(clock.capture, options->screenshot_path))) {
+    fprintf(stderr, "Unable to save %s: %s\n", options->screenshot_path,
+            SDL_GetError());
+    status = 1;
+  }
+  if (options->compare_path &&
+      (clock.capture == NULL ||
+       !compare_images(clock.capture, options->compare_path,
+                       options->tolerance))) {
+    status = 1;
+  }
+  if (options->soak_days > 0 && !finish_soak(&soak)) {
+    status = 1;
+  }
+  if (options->bench) {
+    double median_us = report_frame_times(&clock);
+    if (options->bench_threshold_us > 0 &&
+        median_us > options->bench_threshold_us) {
+      fprintf(stderr, "Median frame time %.1f us exceeds threshold %d us\n",
+              median_us, options->bench_threshold_us);
+      status = 1;
+    }
+  }
+
+  if (clock.checksum_log != NULL && fclose(clock.checksum_log) != 0) {
+    status = 1;
+  }
+  if (clock.pose_log != NULL && fclose(clock.pose_log) != 0) {
+    status = 1;
+  }
+  if (clock.event_log != NULL && fclose(clock.event_log) != 0) {
+    status = 1;
+  }
+  if (clock.replay != NULL) {
+    double recorded = (clock.replay_last_ns - clock.replay_first_ns) / 1e9;
+    double replayed = (monotonic_ns() - clock.stats.start_ns) / 1e9;
+    fprintf(stderr,
+            "replayed %llu frames and %llu events covering %.1f s in "
+            "%.2f s (%.0fx real time)\n",
+            (unsigned long long)clock.frame_count,
+            (unsigned long long)clock.replay_events, recorded, replayed,
+            replayed > 0 ? recorded / replayed : 0);
+  }
+  double sync_p99_ms = stop_phase_sync(&clock.sync);
+  if (options->sync_role == SYNC_FOLLOWER && options->sync_threshold_us > 0 &&
+      (sync_p99_ms < 0 || sync_p99_ms * 1e3 > options->sync_threshold_us)) {
+    fprintf(stderr, "Phase error p99 exceeds threshold %d us\n",
+            options->sync_threshold_us);
+    status = 1;
+  }
+  stop_screenshot_worker(&clock.screenshots);
+  stop_frame_share(&clock);
+  stop_watchdog(&clock.watchdog);
+  stop_metrics_exporter(&clock.metrics);
+  stop_stats_server(&clock.stats_server);
+  stop_face_reloader(&clock.reloader);
+  cleanup_clock(&clock);
+  free(config_text);
+  return status;
 }
@@ -0,0 +1,227 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "frame_share.h"
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+// Reads frames from a ring published by `clock --share NAME`, in place.
+// By default prints one line per frame; --bench reads every pixel of each
+// frame, as a compositor would, and prints throughput once the clock exits.
+
+#define ATTACH_TIMEOUT_NS 5000000000ULL
+#define FRAME_WAIT_NS 100000000 // how often a quiet ring is re-checked
+#define MAX_LATENCIES (1 << 20)
+
+uint64_t monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+// Waits for the clock to create and initialize the segment. *inode
+// identifies the segment mapped.
+const FrameShareHeader *attach(const char *name, size_t *size, ino_t *inode) {
+  uint64_t deadline = monotonic_ns() + ATTACH_TIMEOUT_NS;
+  while (monotonic_ns() < deadline) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 &&
+        (size_t)st.st_size >= sizeof(FrameShareHeader)) {
+      void *mapping =
+          mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      close(fd);
+      if (mapping == MAP_FAILED) {
+        return NULL;
+      }
+      const FrameShareHeader *header = mapping;
+      while (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) !=
+                 FRAME_SHARE_MAGIC &&
+             monotonic_ns() < deadline) {
+        usleep(1000);
+      }
+      if (header->magic != FRAME_SHARE_MAGIC ||
+          header->version != FRAME_SHARE_VERSION ||
+          header->slot_count > FRAME_SHARE_SLOTS ||
+          header->frame_offset +
+                  (size_t)header->frame_size * header->slot_count >
+              (size_t)st.st_size) {
+        munmap(mapping, (size_t)st.st_size);
+        return NULL;
+      }
+      *size = (size_t)st.st_size;
+      *inode = st.st_ino;
+      return header;
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+    usleep(10000);
+  }
+  errno = ETIMEDOUT;
+  return NULL;
+}
+
+// Blocks until `latest` moves past seen, or for at most FRAME_WAIT_NS.
+void wait_for_frame(const FrameShareHeader *header, uint32_t seen) {
+#ifdef __linux__
+  struct timespec timeout = {0, FRAME_WAIT_NS};
+  syscall(SYS_futex, &header->latest, FUTEX_WAIT, seen, &timeout, NULL, 0);
+#else
+  uint64_t deadline = monotonic_ns() + FRAME_WAIT_NS;
+  while (__atomic_load_n(&header->latest, __ATOMIC_ACQUIRE) == seen &&
+         monotonic_ns() < deadline) {
+    usleep(1000);
+  }
+#endif
+}
+
+// A segment left by a crashed run looks live (magic set, never closed), and
+// the clock unlinks and recreates it on start. The name then refers to a
+// different inode than the one mapped.
+int replaced(const char *name, ino_t inode) {
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    return 0;
+  }
+  struct stat st;
+  int moved = fstat(fd, &st) == 0 && st.st_ino != inode;
+  close(fd);
+  return moved;
+}
+
+int main(int argc, char **argv) {
+  int bench = argc == 3 && strcmp(argv[1], "--bench") == 0;
+  if (argc != 2 && !bench) {
+    fprintf(stderr, "Usage: %s [--bench] /NAME\n", argv[0]);
+    return 1;
+  }
+
+  const char *name = argv[argc - 1];
+  size_t size;
+  ino_t inode;
+  const FrameShareHeader *header = attach(name, &size, &inode);
+  if (header == NULL) {
+    fprintf(stderr, "%s: no version %d frame ring (%s)\n", name,
+            FRAME_SHARE_VERSION, strerror(errno));
+    return 1;
+  }
+
+  uint64_t *latencies =
+      bench ? malloc(MAX_LATENCIES * sizeof(uint64_t)) : NULL;
+  if (bench && latencies == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+  uint64_t received = 0, torn = 0, missed = 0, checksum = 0;
+  size_t latency_count = 0;
+  uint32_t seen = __atomic_load_n(&header->latest, __ATOMIC_ACQUIRE);
+  uint64_t start_ns = monotonic_ns();
+
+  while (!__atomic_load_n(&header->closed, __ATOMIC_ACQUIRE)) {
+    wait_for_frame(header, seen);
+    uint32_t latest = __atomic_load_n(&header->latest, __ATOMIC_ACQUIRE);
+    if (latest == seen && replaced(name, inode)) {
+      munmap((void *)header, size);
+      header = attach(name, &size, &inode);
+      if (header == NULL) {
+        fprintf(stderr, "%s: frame ring replaced, reattach failed (%s)\n",
+                name, strerror(errno));
+        free(latencies);
+        return 1;
+      }
+      seen = __atomic_load_n(&header->latest, __ATOMIC_ACQUIRE);
+      continue;
+    }
+    if (latest == seen ||
+        __atomic_load_n(&header->closed, __ATOMIC_ACQUIRE)) {
+      continue;
+    }
+    if (seen != 0) {
+      missed += latest - seen - 1;
+    }
+    seen = latest;
+
+    uint32_t index = (latest - 1) % header->slot_count;
+    const FrameShareSlot *slot = &header->slots[index];
+    uint64_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+    if (sequence != (uint64_t)latest * 2) {
+      torn++;
+      continue;
+    }
+    int64_t time_ns = slot->time_ns;
+    uint64_t present_ns = slot->present_ns;
+    uint64_t latency_ns = monotonic_ns() - present_ns;
+
+    // A compositor would sample the pixels here, straight from the mapping
+    const uint8_t *pixels = (const uint8_t *)header + header->frame_offset +
+                            (size_t)header->frame_size * index;
+    if (bench) {
+      // Word by word, whatever the pixel format
+      const uint32_t *words = (const uint32_t *)pixels;
+      size_t word_count = (size_t)header->pitch * header->height / 4;
+      uint64_t sum = 0;
+      for (size_t i = 0; i < word_count; i++) {
+        sum += words[i];
+      }
+      checksum += sum;
+    }
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != sequence) {
+      torn++;
+      continue;
+    }
+    received++;
+
+    if (bench) {
+      if (latency_count < MAX_LATENCIES) {
+        latencies[latency_count++] = latency_ns;
+      }
+    } else {
+      printf("frame %u  time %lld.%03lld  latency %.1f us\n", latest,
+             (long long)(time_ns / 1000000000),
+             (long long)(time_ns / 1000000 % 1000), latency_ns / 1e3);
+    }
+  }
+
+  if (bench) {
+    double seconds = (monotonic_ns() - start_ns) / 1e9;
+    double frame_bytes = (double)header->pitch * header->height;
+    printf("%llu frames in %.2f s: %.0f fps, %.1f MB/s read in place\n",
+           (unsigned long long)received, seconds,
+           seconds > 0 ? received / seconds : 0,
+           seconds > 0 ? received * frame_bytes / seconds / 1e6 : 0);
+    printf("%llu missed, %llu torn (checksum %016llx)\n",
+           (unsigned long long)missed, (unsigned long long)torn,
+           (unsigned long long)checksum);
+    if (latency_count > 0) {
+      qsort(latencies, latency_count, sizeof(uint64_t), compare_u64);
+      printf("publish to read latency  p50 %.1f us  p99 %.1f us  max %.1f "
+             "us\n",
+             latencies[latency_count / 2] / 1e3,
+             latencies[latency_count * 99 / 100] / 1e3,
+             latencies[latency_count - 1] / 1e3);
+    }
+    free(latencies);
+  }
+  munmap((void *)header, size);
+  return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef FRAME_SHARE_H
+#define FRAME_SHARE_H
+
+#include <stdint.h>
+
+// Shared-memory frame ring written by `clock --share NAME` and read by
+// frame_reader: a header, then FRAME_SHARE_SLOTS frames of pixels starting
+// at frame_offset, frame_size bytes apart.
+//
+// Frame n (counting from 1) is drawn into slot (n - 1) % slot_count. The
+// slot's sequence is 2n - 1 while it is being drawn and 2n once complete,
+// after which `latest` becomes n. Readers check the slot's sequence before
+// and after using the pixels and discard the frame if it changed. On Linux
+// the writer does a FUTEX_WAKE on `latest` after each frame.
+
+#define FRAME_SHARE_MAGIC 0x52465343u // "CSFR"
+#define FRAME_SHARE_VERSION 1
+#define FRAME_SHARE_SLOTS 3
+
+typedef struct {
+  uint64_t sequence;
+  int64_t time_ns;     // wall-clock (or virtual) time the frame shows
+  uint64_t present_ns; // monotonic time the frame was completed
+} FrameShareSlot;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t pitch;
+  uint32_t format; // SDL_PixelFormat, XRGB8888 or RGB565
+  uint32_t slot_count;
+  uint32_t frame_offset;
+  uint32_t frame_size;
+  uint32_t latest; // futex word
+  uint32_t closed; // set when the writer exits
+  uint32_t reserved;
+  FrameShareSlot slots[FRAME_SHARE_SLOTS];
+} FrameShareHeader;
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef POSE_LOG_H
+#define POSE_LOG_H
+
+#include <stdint.h>
+
+// Binary log written by `clock --pose-log PATH` and read by pose_reader:
+// a header followed by one fixed-size record per presented frame, in the
+// writer's byte order. A version 1 record is a prefix of a version 2 one.
+
+#define POSE_LOG_MAGIC 0x534f5043u // "CPOS"
+#define POSE_LOG_VERSION 2
+
+#define POSE_LOG_VIRTUAL_TIME 0x1u
+#define POSE_LOG_STOP_TO_GO 0x2u // second hand pauses at 12 each minute
+#define POSE_LOG_TICK 0x4u       // second hand springs to each second
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t flags;
+} PoseLogHeader;
+
+typedef struct {
+  int64_t sample_time_ns; // wall-clock (or virtual) time the pose shows
+  uint64_t sample_ns;     // monotonic time the time was sampled
+  uint64_t present_ns;    // monotonic time SDL_RenderPresent returned
+  float hour_angle;
+  float minute_angle;
+  float second_angle;
+  uint32_t reserved;
+  uint64_t predicted_ns; // monotonic present time the pose was drawn for,
+                         // 0 without --predict-present (and in version 1)
+} PoseRecord;
+
+#endif
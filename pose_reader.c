@@ -0,0 +1,189 @@
+#define _GNU_SOURCE
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pose_log.h"
+
+// Summarizes a frame-pose log written by `clock --pose-log`: how evenly
+// frames were presented, and how far the second hand on screen was from
+// the true time when each frame reached the display.
+
+typedef struct {
+  double *values;
+  size_t count;
+} Series;
+
+int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+double percentile(const Series *series, double fraction) {
+  size_t index = (size_t)(fraction * (series->count - 1) + 0.5);
+  return series->values[index];
+}
+
+void print_series(const char *name, Series *series) {
+  if (series->count == 0) {
+    return;
+  }
+  qsort(series->values, series->count, sizeof(double), compare_doubles);
+
+  double total = 0;
+  for (size_t i = 0; i < series->count; i++) {
+    total += series->values[i];
+  }
+  printf("%-26s mean %9.3f  p50 %9.3f  p99 %9.3f  max %9.3f ms\n", name,
+         total / series->count, percentile(series, 0.5),
+         percentile(series, 0.99), series->values[series->count - 1]);
+}
+
+// Displayed minus true position of the second hand, in milliseconds,
+// wrapped into [-30 s, 30 s). The pose shows the time at predicted_ns when
+// there is one, otherwise the time it was sampled.
+double second_hand_error_ms(const PoseRecord *record) {
+  uint64_t shown_ns =
+      record->predicted_ns != 0 ? record->predicted_ns : record->sample_ns;
+  double true_ns = (double)record->sample_time_ns +
+                   ((double)record->present_ns - (double)shown_ns);
+  double true_ms = fmod(true_ns / 1e6, 60000.0);
+  double shown_ms = record->second_angle / 6.0 * 1000.0;
+
+  double error = fmod(shown_ms - true_ms, 60000.0);
+  if (error < -30000) {
+    error += 60000;
+  } else if (error >= 30000) {
+    error -= 60000;
+  }
+  return error;
+}
+
+int main(int argc, char **argv) {
+  int csv = argc == 3 && strcmp(argv[1], "--csv") == 0;
+  if (argc != 2 && !csv) {
+    fprintf(stderr, "Usage: %s [--csv] POSE_LOG\n", argv[0]);
+    return 1;
+  }
+
+  const char *path = argv[argc - 1];
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    fprintf(stderr, "Unable to open %s\n", path);
+    return 1;
+  }
+
+  PoseLogHeader header;
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      header.magic != POSE_LOG_MAGIC ||
+      !((header.version == 1 &&
+         header.record_size == offsetof(PoseRecord, predicted_ns)) ||
+        (header.version == POSE_LOG_VERSION &&
+         header.record_size == sizeof(PoseRecord)))) {
+    fprintf(stderr, "%s: not a version 1 or %d pose log\n", path,
+            POSE_LOG_VERSION);
+    fclose(file);
+    return 1;
+  }
+
+  size_t capacity = 4096, count = 0;
+  PoseRecord *records = calloc(capacity, sizeof(PoseRecord));
+  while (records != NULL &&
+         fread(&records[count], header.record_size, 1, file) == 1) {
+    if (++count == capacity) {
+      capacity *= 2;
+      PoseRecord *grown = realloc(records, capacity * sizeof(PoseRecord));
+      if (grown == NULL) {
+        free(records);
+      } else {
+        memset(grown + count, 0, (capacity - count) * sizeof(PoseRecord));
+      }
+      records = grown;
+    }
+  }
+  fclose(file);
+  if (records == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+
+  if (csv) {
+    printf("sample_time_ns,sample_ns,present_ns,predicted_ns,hour_angle,"
+           "minute_angle,second_angle,second_error_ms\n");
+    for (size_t i = 0; i < count; i++) {
+      const PoseRecord *r = &records[i];
+      printf("%lld,%llu,%llu,%llu,%.4f,%.4f,%.4f,%.3f\n",
+             (long long)r->sample_time_ns, (unsigned long long)r->sample_ns,
+             (unsigned long long)r->present_ns,
+             (unsigned long long)r->predicted_ns, r->hour_angle,
+             r->minute_angle, r->second_angle, second_hand_error_ms(r));
+    }
+    free(records);
+    return 0;
+  }
+
+  if (count < 2) {
+    printf("%zu frames, nothing to summarize\n", count);
+    free(records);
+    return 0;
+  }
+
+  Series intervals = {calloc(count, sizeof(double)), 0};
+  Series latency = {calloc(count, sizeof(double)), 0};
+  Series error = {calloc(count, sizeof(double)), 0};
+  Series prediction = {calloc(count, sizeof(double)), 0};
+  if (intervals.values == NULL || latency.values == NULL ||
+      error.values == NULL || prediction.values == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    const PoseRecord *r = &records[i];
+    if (i > 0) {
+      intervals.values[intervals.count++] =
+          (r->present_ns - records[i - 1].present_ns) / 1e6;
+    }
+    latency.values[latency.count++] = (r->present_ns - r->sample_ns) / 1e6;
+    error.values[error.count++] = fabs(second_hand_error_ms(r));
+    if (r->predicted_ns != 0) {
+      prediction.values[prediction.count++] =
+          fabs(((double)r->present_ns - (double)r->predicted_ns) / 1e6);
+    }
+  }
+
+  double seconds =
+      (records[count - 1].present_ns - records[0].present_ns) / 1e9;
+  printf("%zu frames over %.1f s (%.2f fps)\n", count, seconds,
+         seconds > 0 ? (count - 1) / seconds : 0);
+
+  print_series("present interval", &intervals);
+  double median = percentile(&intervals, 0.5);
+  size_t stutters = 0;
+  for (size_t i = 0; i < intervals.count; i++) {
+    stutters += intervals.values[i] > median * 1.5;
+  }
+  printf("%-26s %zu (%.2f%%) intervals over 1.5x the median\n", "stutter",
+         stutters, 100.0 * stutters / intervals.count);
+
+  print_series("sample to present", &latency);
+  print_series("|present - predicted|", &prediction);
+  if (header.flags & POSE_LOG_VIRTUAL_TIME) {
+    printf("virtual time: second hand error is not meaningful\n");
+  } else if (header.flags & (POSE_LOG_STOP_TO_GO | POSE_LOG_TICK)) {
+    printf("%s motion: second hand error is not meaningful\n",
+           header.flags & POSE_LOG_TICK ? "ticking" : "stop-to-go");
+  } else {
+    print_series("|second hand error|", &error);
+  }
+
+  free(intervals.values);
+  free(latency.values);
+  free(error.values);
+  free(prediction.values);
+  free(records);
+  return 0;
+}